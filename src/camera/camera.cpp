@@ -84,6 +84,10 @@ glm::mat4 Camera::getProjectionMatrix(bool isPerspective) {
                           height / 2.0f, near, far);
 }
 
+Frustum Camera::getFrustum() {
+  return Frustum::fromMatrix(getProjectionMatrix(true) * getViewMatrix());
+}
+
 void Camera::updateCameraData() {
   glm::vec3 calculatedFront;
   calculatedFront.x = cos(glm::radians(angleXZ)) * cos(glm::radians(angleXY));
@@ -96,3 +100,5 @@ void Camera::updateCameraData() {
 
 const glm::vec3 &Camera::getPosition() const { return position; }
 const glm::vec3 &Camera::getFront() const { return front; }
+float Camera::getNear() const { return near; }
+float Camera::getFar() const { return far; }
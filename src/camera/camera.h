@@ -3,6 +3,7 @@
 #define OPENGL_CAMERA_H
 #define WORLD_UP glm::vec3(0.0f, 1.0f, 0.0f)
 
+#include "frustum.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/vec3.hpp>
@@ -22,8 +23,12 @@ public:
   void processMouseScroll(float yOffset);
   glm::mat4 getViewMatrix();
   glm::mat4 getProjectionMatrix(bool isPerspective);
+  // planes of the perspective view volume in world space
+  Frustum getFrustum();
   const glm::vec3 &getPosition() const;
   const glm::vec3 &getFront() const;
+  float getNear() const;
+  float getFar() const;
   // hdr
   float exposure = 1.0f;
 
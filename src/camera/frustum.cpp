@@ -0,0 +1,107 @@
+
+#include "frustum.h"
+#include <cmath>
+#include <glm/geometric.hpp>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+namespace {
+// spheres per SSE step
+const size_t LANES = 4;
+// padding lanes are never visible
+const float PADDING_RADIUS = -1e30f;
+
+glm::vec4 normalizePlane(const glm::vec4 &plane) {
+  return plane / glm::length(glm::vec3(plane));
+}
+} // namespace
+
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProjection) {
+  // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                        viewProjection[2][i], viewProjection[3][i]);
+  }
+  // -w <= x, y, z <= w in clip space
+  Frustum frustum;
+  frustum.planes[LEFT_PLANE] = normalizePlane(rows[3] + rows[0]);
+  frustum.planes[RIGHT_PLANE] = normalizePlane(rows[3] - rows[0]);
+  frustum.planes[BOTTOM_PLANE] = normalizePlane(rows[3] + rows[1]);
+  frustum.planes[TOP_PLANE] = normalizePlane(rows[3] - rows[1]);
+  frustum.planes[NEAR_PLANE] = normalizePlane(rows[3] + rows[2]);
+  frustum.planes[FAR_PLANE] = normalizePlane(rows[3] - rows[2]);
+  return frustum;
+}
+
+glm::vec4 Frustum::openPlane() { return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); }
+
+void FrustumCuller::clear() {
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  radius.clear();
+}
+
+void FrustumCuller::add(const BoundingSphere &sphere) {
+  centerX.push_back(sphere.center.x);
+  centerY.push_back(sphere.center.y);
+  centerZ.push_back(sphere.center.z);
+  radius.push_back(sphere.radius);
+}
+
+size_t FrustumCuller::size() const { return radius.size(); }
+
+void FrustumCuller::cull(const Frustum &frustum,
+                         std::vector<unsigned char> &visible) {
+  size_t count = size();
+  visible.resize(count);
+  if (count == 0) {
+    return;
+  }
+  // pad to whole batches, the padding is dropped again below
+  size_t padded = (count + LANES - 1) / LANES * LANES;
+  centerX.resize(padded, 0.0f);
+  centerY.resize(padded, 0.0f);
+  centerZ.resize(padded, 0.0f);
+  radius.resize(padded, PADDING_RADIUS);
+
+#ifdef FRUSTUM_SSE
+  const __m128 zero = _mm_setzero_ps();
+  for (size_t i = 0; i < padded; i += LANES) {
+    __m128 x = _mm_loadu_ps(&centerX[i]);
+    __m128 y = _mm_loadu_ps(&centerY[i]);
+    __m128 z = _mm_loadu_ps(&centerZ[i]);
+    __m128 r = _mm_loadu_ps(&radius[i]);
+    __m128 inside = _mm_cmpge_ps(r, zero);
+    for (const glm::vec4 &plane : frustum.planes) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                     _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                     _mm_set1_ps(plane.w)));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+    }
+    int mask = _mm_movemask_ps(inside);
+    for (size_t lane = 0; lane < LANES && i + lane < count; ++lane) {
+      visible[i + lane] = (mask >> lane) & 1;
+    }
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    bool inside = true;
+    for (const glm::vec4 &plane : frustum.planes) {
+      float distance = plane.x * centerX[i] + plane.y * centerY[i] +
+                       plane.z * centerZ[i] + plane.w;
+      inside = inside && distance + radius[i] >= 0.0f;
+    }
+    visible[i] = inside;
+  }
+#endif
+  centerX.resize(count);
+  centerY.resize(count);
+  centerZ.resize(count);
+  radius.resize(count);
+}
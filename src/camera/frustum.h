@@ -0,0 +1,52 @@
+
+#ifndef OPENGL_FRUSTUM_H
+#define OPENGL_FRUSTUM_H
+
+#include "../scene/boundingvolume.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+// six normalized planes facing inwards, a point p is inside a plane when
+// dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+  enum Plane {
+    LEFT_PLANE,
+    RIGHT_PLANE,
+    BOTTOM_PLANE,
+    TOP_PLANE,
+    NEAR_PLANE,
+    FAR_PLANE,
+    PLANE_NUM
+  };
+  glm::vec4 planes[PLANE_NUM];
+
+  // the clip volume of viewProjection in world space (Gribb-Hartmann)
+  static Frustum fromMatrix(const glm::mat4 &viewProjection);
+  // a plane nothing is outside of, to switch a face off
+  static glm::vec4 openPlane();
+};
+
+/**
+ * tests world space bounding spheres against a frustum in batches. the
+ * spheres are kept as separate x, y, z and radius arrays so that one SSE
+ * step tests 4 of them against a plane, a scalar loop is used without SSE.
+ * keeps its memory across frames, clear() it before each pass.
+ */
+class FrustumCuller {
+public:
+  void clear();
+  void add(const BoundingSphere &sphere);
+  size_t size() const;
+  // visible[i] is 1 when sphere i touches the frustum, 0 when it is fully
+  // outside one of the planes
+  void cull(const Frustum &frustum, std::vector<unsigned char> &visible);
+
+private:
+  std::vector<float> centerX;
+  std::vector<float> centerY;
+  std::vector<float> centerZ;
+  std::vector<float> radius;
+};
+
+#endif // OPENGL_FRUSTUM_H
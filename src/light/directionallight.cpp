@@ -1,8 +1,15 @@
 
 #include "directionallight.h"
+#include "../renderengine/gldebug.h"
+#include "../renderengine/glstate.h"
 #include "../renderengine/render.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+
+namespace {
+const UniformID LIGHT_SPACE_TRANS = ShaderProgram::uniformID("lightSpaceTrans");
+} // namespace
+
 DirectionalLight::DirectionalLight(const glm::vec3 &ambient,
                                    const glm::vec3 &diffuse,
                                    const glm::vec3 &specular,
@@ -16,19 +23,16 @@ DirectionalLight::DirectionalLight(const glm::vec3 &ambient,
   genShadowMap();
 }
 
-void DirectionalLight::configure(ShaderProgram &shaderProgram,
-                                 std::string lightType, std::string index) {
-  Light::configure(shaderProgram, lightType, index);
-  shaderProgram.uniformSetMat4(lightType + "s[" + index + "].lightSpaceTrans",
-                               lightSpaceTrans);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].direction",
-                                direction);
+void DirectionalLight::pack(LightRecord &record) const {
+  Light::pack(record);
+  record.directionConstant = glm::vec4(direction, 1.0f);
+  record.lightSpaceTrans = lightSpaceTrans;
 }
 
 void DirectionalLight::genShadowMap() {
   // shadow map texture
   glGenTextures(1, &depthMapTex);
-  glBindTexture(GL_TEXTURE_2D, depthMapTex);
+  GLState::bindTexture(GL_TEXTURE_2D, depthMapTex);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH,
                SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -40,7 +44,8 @@ void DirectionalLight::genShadowMap() {
 
   // framebuffer
   glGenFramebuffers(1, &shadowMapFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+  GLDebug::label(GL_FRAMEBUFFER, shadowMapFBO, "directional shadow map");
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
                          depthMapTex, 0);
   glDrawBuffer(GL_NONE);
@@ -53,15 +58,24 @@ void DirectionalLight::genShadowMap() {
   }
 
   // unbind
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void DirectionalLight::configureShadowMatrices(ShaderProgram &shaderProgram) {
-  shaderProgram.uniformSetMat4("lightSpaceTrans", lightSpaceTrans);
+  shaderProgram.uniformSetMat4(LIGHT_SPACE_TRANS, lightSpaceTrans);
+}
+
+Frustum DirectionalLight::shadowFrustum() const {
+  Frustum frustum = Frustum::fromMatrix(lightSpaceTrans);
+  // casters between the light and its near plane still throw shadows
+  frustum.planes[Frustum::NEAR_PLANE] = Frustum::openPlane();
+  return frustum;
 }
 
 void DirectionalLight::activeShadowTex() {
-  glActiveTexture(GL_TEXTURE0 + depthMapIndex);
-  glBindTexture(GL_TEXTURE_2D, depthMapTex);
+  if (depthMapIndex < 0) {
+    return;
+  }
+  GLState::bindTexture(depthMapIndex, GL_TEXTURE_2D, depthMapTex);
 }
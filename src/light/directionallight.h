@@ -8,10 +8,10 @@ public:
   DirectionalLight(const glm::vec3 &ambient, const glm::vec3 &diffuse,
                    const glm::vec3 &specular, const LightType lightType,
                    const glm::vec3 &direction);
-  void configure(ShaderProgram &shaderProgram, std::string lightType,
-                 std::string index) override;
+  void pack(LightRecord &record) const override;
   void configureShadowMatrices(ShaderProgram &shaderProgram) override;
   void activeShadowTex() override;
+  Frustum shadowFrustum() const override;
 
   glm::vec3 direction;
   glm::mat4 lightSpaceTrans;
@@ -7,28 +7,20 @@ FlashLight::FlashLight(const glm::vec3 &ambient, const glm::vec3 &diffuse,
     : Light(camera->getPosition(), ambient, diffuse, specular, lightType),
       constTerm(constTerm), linearTerm(linearTerm),
       quadraticTerm(quadraticTerm), cutoffCos(cutoffCos),
-      outCutoffCos(outCutoffCos), camera(camera) {}
+      outCutoffCos(outCutoffCos), camera(camera) {
+  castsShadow = false;
+}
 
-void FlashLight::configure(ShaderProgram &shaderProgram, std::string lightType,
-                           std::string index) {
-  Light::configure(shaderProgram, lightType, index);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].position",
-                                camera->getPosition());
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].direction",
-                                camera->getFront());
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].constant",
-                                constTerm);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].linear",
-                                linearTerm);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].quadratic",
-                                quadraticTerm);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].cutoff",
-                                cutoffCos);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].outCutoff",
-                                outCutoffCos);
+void FlashLight::pack(LightRecord &record) const {
+  Light::pack(record);
+  record.positionShadow = glm::vec4(camera->getPosition(), -1.0f);
+  record.directionConstant = glm::vec4(camera->getFront(), constTerm);
+  record.ambientLinear.w = linearTerm;
+  record.diffuseQuadratic.w = quadraticTerm;
+  record.cutoffs = glm::vec4(cutoffCos, outCutoffCos, 0.0f, 0.0f);
 }
 
-void FlashLight::configureShadowMatrices(ShaderProgram &shaderProgram) {}
+void FlashLight::configureShadowMatrices(ShaderProgram &) {}
 
 void FlashLight::activeShadowTex() {}
 
@@ -10,8 +10,7 @@ public:
              const glm::vec3 &specular, const LightType lightType,
              float constTerm, float linearTerm, float quadraticTerm,
              float cutoffCos, float outCutoffCos, Camera *camera);
-  void configure(ShaderProgram &shaderProgram, std::string lightType,
-                 std::string index) override;
+  void pack(LightRecord &record) const override;
   void configureShadowMatrices(ShaderProgram &shaderProgram) override;
   void activeShadowTex() override;
 
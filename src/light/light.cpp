@@ -7,14 +7,22 @@ Light::Light(const glm::vec3 position, const glm::vec3 &ambient,
     : position(position), ambient(ambient), diffuse(diffuse),
       specular(specular), lightType(lightType) {}
 
-void Light::configure(ShaderProgram &shaderProgram, std::string lightType,
-                      std::string index) {
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].ambient",
-                                ambient);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].diffuse",
-                                diffuse);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].specular",
-                                specular);
-  shaderProgram.uniformSetInt(lightType + "s[" + index + "].shadowMap",
-                              depthMapIndex);
-}
\ No newline at end of file
+Frustum Light::shadowFrustum() const {
+  Frustum frustum;
+  for (glm::vec4 &plane : frustum.planes) {
+    plane = Frustum::openPlane();
+  }
+  return frustum;
+}
+
+bool Light::shadowSphere(glm::vec3 &, float &) const { return false; }
+
+void Light::pack(LightRecord &record) const {
+  record.positionShadow = glm::vec4(position, -1.0f);
+  record.ambientLinear = glm::vec4(ambient, 0.0f);
+  record.diffuseQuadratic = glm::vec4(diffuse, 0.0f);
+  record.specularFarPlane = glm::vec4(specular, 0.0f);
+  record.directionConstant = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  record.cutoffs = glm::vec4(0.0f);
+  record.lightSpaceTrans = glm::mat4(1.0f);
+}
@@ -4,35 +4,50 @@
 
 #include "../camera/camera.h"
 #include "../renderengine/shader.h"
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
-#include <string>
+#include <glm/vec4.hpp>
 
 enum class LightType : int { DIRECT, POINT, SPOT, FLASH };
 
-static std::string LightTypeToString(LightType lightType) {
-  std::string table[] = {"directLight", "pointLight", "spotLight", "spotLight"};
-  return table[(int)lightType];
-}
+// one light in the LightBuffer, LIGHT_TEXELS rgba32f texels in the shaders
+struct LightRecord {
+  glm::vec4 positionShadow; // xyz position, w directShadowMaps slot or -1
+  glm::vec4 directionConstant;
+  glm::vec4 ambientLinear;
+  glm::vec4 diffuseQuadratic;
+  glm::vec4 specularFarPlane;
+  glm::vec4 cutoffs; // cos cutoff, cos outCutoff
+  glm::mat4 lightSpaceTrans;
+};
 
 class Light {
 public:
   Light(const glm::vec3 position, const glm::vec3 &ambient,
         const glm::vec3 &diffuse, const glm::vec3 &specular,
         const LightType lightType);
-  virtual void configure(ShaderProgram &shaderProgram, std::string lightType,
-                         std::string index) = 0;
+  // fills this light's fields of its LightBuffer record
+  virtual void pack(LightRecord &record) const = 0;
   virtual void configureShadowMatrices(ShaderProgram &shaderProgram) = 0;
   virtual void activeShadowTex() = 0;
+  // what the shadow pass can see, meshes outside are culled from it.
+  // nothing is culled for lights without an own volume
+  virtual Frustum shadowFrustum() const;
+  // the reach of the shadow pass as a sphere, which the scene BVH queries
+  // instead of shadowFrustum. false for lights without one
+  virtual bool shadowSphere(glm::vec3 &center, float &radius) const;
 
   glm::vec3 position;
   glm::vec3 ambient;
   glm::vec3 diffuse;
   glm::vec3 specular;
   LightType lightType;
-  // for shadow map
-  GLuint shadowMapFBO;
-  GLuint depthMapTex;
-  int depthMapIndex = 0;
+  // for shadow map, lights without one skip the shadow passes
+  bool castsShadow = true;
+  GLuint shadowMapFBO = 0;
+  GLuint depthMapTex = 0;
+  // texture unit of the shadow map, -1 when the shaders do not sample it
+  int depthMapIndex = -1;
 
 private:
   virtual void genShadowMap() = 0;
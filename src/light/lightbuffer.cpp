@@ -0,0 +1,124 @@
+
+#include "lightbuffer.h"
+#include "../renderengine/gldebug.h"
+#include "../renderengine/glstate.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+static_assert(sizeof(LightRecord) == 10 * 4 * sizeof(float),
+              "LightRecord must match LIGHT_TEXELS in the shaders");
+
+namespace {
+const UniformID LIGHT_DATA = ShaderProgram::uniformID("lightData");
+const UniformID DIR_NUM = ShaderProgram::uniformID("dirNum");
+const UniformID POINT_NUM = ShaderProgram::uniformID("pointNum");
+const UniformID SPOT_NUM = ShaderProgram::uniformID("spotNum");
+
+std::vector<UniformID> shadowMapIDs() {
+  std::vector<UniformID> ids;
+  for (int i = 0; i < LightBuffer::DIRECT_SHADOW_MAPS; ++i) {
+    ids.push_back(ShaderProgram::uniformID("directShadowMaps[" +
+                                           std::to_string(i) + "]"));
+  }
+  return ids;
+}
+const std::vector<UniformID> DIRECT_SHADOW_MAP_IDS = shadowMapIDs();
+
+int typeOrder(LightType lightType) {
+  // FLASH is a spot light that follows the camera
+  return lightType == LightType::FLASH ? (int)LightType::SPOT
+                                       : (int)lightType;
+}
+} // namespace
+
+LightBuffer::LightBuffer(LightBuffer &&other) noexcept {
+  *this = std::move(other);
+}
+
+LightBuffer &LightBuffer::operator=(LightBuffer &&other) noexcept {
+  if (this != &other) {
+    cleanUp();
+    TBO = other.TBO;
+    texture = other.texture;
+    capacity = other.capacity;
+    records = std::move(other.records);
+    uploaded = std::move(other.uploaded);
+    dirNum = other.dirNum;
+    pointNum = other.pointNum;
+    spotNum = other.spotNum;
+    other.TBO = other.texture = 0;
+    other.capacity = 0;
+  }
+  return *this;
+}
+
+void LightBuffer::update(std::vector<Light *> &lights) {
+  records.resize(lights.size());
+  int counts[3] = {0, 0, 0};
+  for (Light *light : lights) {
+    ++counts[typeOrder(light->lightType)];
+  }
+  int next[3] = {0, counts[0], counts[0] + counts[1]};
+  int shadowSlot = 0;
+  for (Light *light : lights) {
+    LightRecord &record = records[next[typeOrder(light->lightType)]++];
+    light->pack(record);
+    light->depthMapIndex = -1;
+    if (light->lightType == LightType::DIRECT && light->castsShadow &&
+        shadowSlot < DIRECT_SHADOW_MAPS) {
+      record.positionShadow.w = float(shadowSlot);
+      light->depthMapIndex = SHADOW_TEXTURE_UNIT + shadowSlot++;
+    }
+  }
+  dirNum = counts[0];
+  pointNum = counts[1];
+  spotNum = counts[2];
+
+  size_t bytes = records.size() * sizeof(LightRecord);
+  if (records.size() == uploaded.size() &&
+      (bytes == 0 || memcmp(records.data(), uploaded.data(), bytes) == 0)) {
+    return;
+  }
+  if (TBO == 0) {
+    glGenBuffers(1, &TBO);
+    glGenTextures(1, &texture);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+  if (bytes > capacity) {
+    // grow geometrically so that adding lights one by one stays cheap
+    capacity = std::max(bytes, capacity * 2);
+    glBufferData(GL_TEXTURE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+    GLDebug::label(GL_BUFFER, TBO, "lights");
+    GLState::bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+  }
+  if (bytes > 0) {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, records.data());
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  uploaded = records;
+}
+
+void LightBuffer::configure(ShaderProgram &shaderProgram) {
+  GLState::bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+  shaderProgram.uniformSetInt(LIGHT_DATA, TEXTURE_UNIT);
+  for (int i = 0; i < DIRECT_SHADOW_MAPS; ++i) {
+    shaderProgram.uniformSetInt(DIRECT_SHADOW_MAP_IDS[i],
+                                SHADOW_TEXTURE_UNIT + i);
+  }
+  shaderProgram.uniformSetInt(DIR_NUM, dirNum);
+  shaderProgram.uniformSetInt(POINT_NUM, pointNum);
+  shaderProgram.uniformSetInt(SPOT_NUM, spotNum);
+}
+
+void LightBuffer::cleanUp() {
+  if (TBO) {
+    glDeleteBuffers(1, &TBO);
+    GLState::deleteTextures(1, &texture);
+    TBO = texture = 0;
+  }
+  capacity = 0;
+  records.clear();
+  uploaded.clear();
+}
@@ -0,0 +1,51 @@
+
+#ifndef OPENGL_LIGHTBUFFER_H
+#define OPENGL_LIGHTBUFFER_H
+
+#include "light.h"
+#include <glad/glad.h>
+#include <vector>
+
+/**
+ * every light of a scene packed into a texture buffer (GL_RGBA32F), read
+ * with texelFetch in the lighting shaders, so there is no cap on the light
+ * count. records are ordered directional, point, then spot lights.
+ * the records are repacked on update and only uploaded when they changed,
+ * e.g. when a light moves or one is added.
+ */
+class LightBuffer {
+public:
+  // texture unit of the lightData samplerBuffer, after the material and
+  // G-buffer textures (units 0-3)
+  static const int TEXTURE_UNIT = 4;
+  // directional lights whose shadow map is sampled, must match the shaders
+  static const int DIRECT_SHADOW_MAPS = 4;
+  // first unit of the directShadowMaps samplers
+  static const int SHADOW_TEXTURE_UNIT = TEXTURE_UNIT + 1;
+
+  LightBuffer() = default;
+  LightBuffer(const LightBuffer &) = delete;
+  LightBuffer &operator=(const LightBuffer &) = delete;
+  LightBuffer(LightBuffer &&other) noexcept;
+  LightBuffer &operator=(LightBuffer &&other) noexcept;
+  // repacks lights, assigns their shadow map units and uploads on change
+  void update(std::vector<Light *> &lights);
+  // binds the buffer and sets the light counts and samplers of a program
+  void configure(ShaderProgram &shaderProgram);
+  void cleanUp();
+
+  int dirNum = 0;
+  int pointNum = 0;
+  int spotNum = 0;
+
+private:
+  GLuint TBO = 0;
+  GLuint texture = 0;
+  // bytes allocated for TBO
+  size_t capacity = 0;
+  std::vector<LightRecord> records;
+  // what TBO currently holds
+  std::vector<LightRecord> uploaded;
+};
+
+#endif // OPENGL_LIGHTBUFFER_H
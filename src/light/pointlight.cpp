@@ -1,37 +1,50 @@
 #include "pointlight.h"
+#include "../renderengine/gldebug.h"
+#include "../renderengine/glstate.h"
 #include "../renderengine/render.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+
+namespace {
+const UniformID SHADOW_MATRICES[6] = {
+    ShaderProgram::uniformID("shadowMatrices[0]"),
+    ShaderProgram::uniformID("shadowMatrices[1]"),
+    ShaderProgram::uniformID("shadowMatrices[2]"),
+    ShaderProgram::uniformID("shadowMatrices[3]"),
+    ShaderProgram::uniformID("shadowMatrices[4]"),
+    ShaderProgram::uniformID("shadowMatrices[5]")};
+const UniformID FAR = ShaderProgram::uniformID("far");
+const UniformID LIGHT_POS = ShaderProgram::uniformID("lightPos");
+} // namespace
+
 PointLight::PointLight(const glm::vec3 &ambient, const glm::vec3 &diffuse,
                        const glm::vec3 &specular, const LightType lightType,
                        const glm::vec3 &position, float constTerm,
-                       float linearTerm, float quadraticTerm)
+                       float linearTerm, float quadraticTerm,
+                       bool castsShadow)
     : Light(position, ambient, diffuse, specular, lightType),
       constTerm(constTerm), linearTerm(linearTerm),
       quadraticTerm(quadraticTerm) {
-  genShadowMap();
+  // a cube shadow map is 6 depth layers, most fill lights go without
+  this->castsShadow = castsShadow;
+  if (castsShadow) {
+    genShadowMap();
+  }
 }
 
-void PointLight::configure(ShaderProgram &shaderProgram, std::string lightType,
-                           std::string index) {
-  Light::configure(shaderProgram, lightType, index);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].constant",
-                                constTerm);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].linear",
-                                linearTerm);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].quadratic",
-                                quadraticTerm);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].position",
-                                position);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].farPlane",
-                                farPlane);
+void PointLight::pack(LightRecord &record) const {
+  Light::pack(record);
+  record.directionConstant.w = constTerm;
+  record.ambientLinear.w = linearTerm;
+  record.diffuseQuadratic.w = quadraticTerm;
+  record.specularFarPlane.w = farPlane;
 }
 
 void PointLight::genShadowMap() {
   glGenFramebuffers(1, &shadowMapFBO);
   // create depth cubemap texture
   glGenTextures(1, &depthMapTex);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, depthMapTex);
+  GLState::bindTexture(GL_TEXTURE_CUBE_MAP, depthMapTex);
   for (unsigned int i = 0; i < 6; ++i)
     glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
                  SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
@@ -42,7 +55,8 @@ void PointLight::genShadowMap() {
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
   // attach depth texture as FBO's depth buffer
-  glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+  GLDebug::label(GL_FRAMEBUFFER, shadowMapFBO, "point shadow map");
   glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMapTex, 0);
   glDrawBuffer(GL_NONE);
   glReadBuffer(GL_NONE);
@@ -53,8 +67,14 @@ void PointLight::genShadowMap() {
   }
 
   // unbind
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+bool PointLight::shadowSphere(glm::vec3 &center, float &radius) const {
+  center = position;
+  radius = farPlane;
+  return true;
 }
 
 void PointLight::configureShadowMatrices(ShaderProgram &shaderProgram) {
@@ -86,15 +106,16 @@ void PointLight::configureShadowMatrices(ShaderProgram &shaderProgram) {
                                position + glm::vec3(0.0f, 0.0f, -1.0f),
                                glm::vec3(0.0f, -1.0f, 0.0f)));
   for (unsigned int i = 0; i < 6; ++i) {
-    shaderProgram.uniformSetMat4("shadowMatrices[" + std::to_string(i) + "]",
-                                 shadowTransforms[i]);
+    shaderProgram.uniformSetMat4(SHADOW_MATRICES[i], shadowTransforms[i]);
   }
 
-  shaderProgram.uniformSetFloat("far", farPlane);
-  shaderProgram.uniformSetVec3F("lightPos", position);
+  shaderProgram.uniformSetFloat(FAR, farPlane);
+  shaderProgram.uniformSetVec3F(LIGHT_POS, position);
 }
 
 void PointLight::activeShadowTex() {
-  glActiveTexture(GL_TEXTURE0 + depthMapIndex);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, depthMapTex);
+  if (depthMapIndex < 0) {
+    return;
+  }
+  GLState::bindTexture(depthMapIndex, GL_TEXTURE_CUBE_MAP, depthMapTex);
 }
@@ -9,16 +9,17 @@ public:
   PointLight(const glm::vec3 &ambient, const glm::vec3 &diffuse,
              const glm::vec3 &specular, const LightType lightType,
              const glm::vec3 &position, float constTerm, float linearTerm,
-             float quadraticTerm);
-  void configure(ShaderProgram &shaderProgram, std::string lightType,
-                 std::string index) override;
+             float quadraticTerm, bool castsShadow = true);
+  void pack(LightRecord &record) const override;
   void configureShadowMatrices(ShaderProgram &shaderProgram) override;
   void activeShadowTex() override;
+  // the 6 cube faces together see farPlane in every direction
+  bool shadowSphere(glm::vec3 &center, float &radius) const override;
 
   float constTerm;
   float linearTerm;
   float quadraticTerm;
-  float farPlane;
+  float farPlane = 5.0f;
 
 private:
   void genShadowMap() override;
@@ -6,18 +6,13 @@ SpotLight::SpotLight(const glm::vec3 &ambient, const glm::vec3 &diffuse,
                      const glm::vec3 &position, float constTerm,
                      float linearTerm, float quadraticTerm,
                      const glm::vec3 &direction, float cutoffCos,
-                     float outCutoffCos)
+                     float outCutoffCos, bool castsShadow)
     : PointLight(ambient, diffuse, specular, lightType, position, constTerm,
-                 linearTerm, quadraticTerm),
+                 linearTerm, quadraticTerm, castsShadow),
       direction(direction), cutoffCos(cutoffCos), outCutoffCos(outCutoffCos) {}
 
-void SpotLight::configure(ShaderProgram &shaderProgram, std::string lightType,
-                          std::string index) {
-  PointLight::configure(shaderProgram, lightType, index);
-  shaderProgram.uniformSetVec3F(lightType + "s[" + index + "].direction",
-                                direction);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].cutoff",
-                                cutoffCos);
-  shaderProgram.uniformSetFloat(lightType + "s[" + index + "].outCutoff",
-                                outCutoffCos);
+void SpotLight::pack(LightRecord &record) const {
+  PointLight::pack(record);
+  record.directionConstant = glm::vec4(direction, constTerm);
+  record.cutoffs = glm::vec4(cutoffCos, outCutoffCos, 0.0f, 0.0f);
 }
@@ -9,9 +9,8 @@ public:
             const glm::vec3 &specular, const LightType lightType,
             const glm::vec3 &position, float constTerm, float linearTerm,
             float quadraticTerm, const glm::vec3 &direction, float cutoffCos,
-            float outCutoffCos);
-  void configure(ShaderProgram &shaderProgram, std::string lightType,
-                 std::string index) override;
+            float outCutoffCos, bool castsShadow = true);
+  void pack(LightRecord &record) const override;
 
   glm::vec3 direction;
   float cutoffCos;
@@ -3,15 +3,28 @@
 #endif
 
 #include "light/directionallight.h"
+#include "material/materialtable.h"
 #include "renderengine/displaymanager.h"
+#include "renderengine/gldebug.h"
+#include "renderengine/glext.h"
+#include "renderengine/glstate.h"
 #include "renderengine/render.h"
+#include "utils/frametimer.h"
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <memory>
 
 int SCR_WIDTH = 800;
 int SCR_HEIGHT = 600;
+// decoded texture bytes pushed to the GPU per frame while assets stream in
+size_t TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+// frames averaged per cpu frame time report
+unsigned int FRAME_REPORT_INTERVAL = 300;
+// false keeps the G-buffer pass on the cpu culling path: occlusion test and
+// front to back order instead of no per mesh cpu work
+bool GPU_CULL_GBUFFER = true;
 
 int main() {
   /**
@@ -29,26 +42,29 @@ int main() {
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
+  GLExt::load((GLADloadproc)glfwGetProcAddress);
+  GLDebug::enable((GLADloadproc)glfwGetProcAddress);
 
   /**
    * gl global configuration
    */
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_STENCIL_TEST);
+  GLState::enable(GL_DEPTH_TEST);
+  GLState::enable(GL_STENCIL_TEST);
   //  glEnable(GL_BLEND);
   //  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_CULL_FACE);
+  GLState::enable(GL_CULL_FACE);
   glCullFace(GL_BACK);
-  glEnable(GL_MULTISAMPLE);
+  GLState::enable(GL_MULTISAMPLE);
 
   /**
    * scene
    */
+  TextureUploader textureUploader(TEXTURE_UPLOAD_BUDGET);
   std::vector<Model> models;
   Transformation transformation(glm::vec3(0.0f, -0.75f, 0.0f),
                                 glm::vec3(0.0005f, 0.0005f, 0.0005f), nullptr);
-  Model model("../resources/Sponza-master/sponza.obj", transformation);
-  models.push_back(model);
+  models.emplace_back("../resources/Sponza-master/sponza.obj", transformation,
+                      &textureUploader, GeometryResidency::RELEASE);
 
   // lights
   std::vector<Light *> lights;
@@ -76,7 +92,7 @@ int main() {
       "../resources/skybox/front.jpg", "../resources/skybox/back.jpg"};
   SkyBox skyBox(skyTexs);
 
-  Scene scene = Scene(models, &camera, lights, &skyBox);
+  Scene scene(std::move(models), &camera, lights, &skyBox);
   std::vector<GBufferTexture> gBufferTexs{
       {GBUFFER_TEXTURE_TYPE_POSITION, "gPosition"},
       {GBUFFER_TEXTRURE_NORMAL, "gNormal"},
@@ -155,12 +171,30 @@ int main() {
       {GL_FRAGMENT_SHADER, "../src/shaders/gbuffer/lightpassFrag.shader"}};
   ShaderProgram lightpassShader = ShaderProgram(lightpassShaders);
 
+  // frustum culling of the shadow and G-buffer passes on the gpu, the cpu
+  // path stays for contexts without compute shaders and count draws
+  std::unique_ptr<ShaderProgram> cullShader;
+  if (GLExt::hasGpuCulling()) {
+    std::vector<ShaderInfo> cullShaders{
+        {GL_COMPUTE_SHADER, "../src/shaders/cull/cullCompute.shader"}};
+    cullShader.reset(new ShaderProgram(cullShaders));
+    Render::setGpuCulling(cullShader.get(), GPU_CULL_GBUFFER);
+  }
+
+  // material parameters come from the MaterialTable uniform buffer
+  MaterialTable::configure(modelShader);
+  MaterialTable::configure(gbufferShader);
+
   /**
    * render loop
    */
+  FrameTimer frameTimer("cpu frame", FRAME_REPORT_INTERVAL);
   while (!displayManager.shouldClose()) {
+    frameTimer.begin();
 
     displayManager.interactionCallback();
+    textureUploader.update();
+    scene.bvh.refit(scene.models);
 
     // shadow map
     directShadowShader.use();
@@ -187,10 +221,10 @@ int main() {
 
     // copy geometry's depth buffer to default framebuffer
     scene.gBuffer.bindForRead();
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT,
                       GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // post- processing
 
@@ -240,13 +274,45 @@ int main() {
     //    normalShader.use();
     //    Render::render(scene, normalShader);
 
+    GLState::endFrame();
+    frameTimer.count("gl calls elided", GLState::elidedCalls());
+    frameTimer.count("gl calls issued", GLState::issuedCalls());
+    frameTimer.count("meshes culled, shadow",
+                     Render::culledMeshes(RenderPass::SHADOW));
+    frameTimer.count("meshes culled, G-buffer",
+                     Render::culledMeshes(RenderPass::GBUFFER));
+    frameTimer.count("meshes culled, forward",
+                     Render::culledMeshes(RenderPass::FORWARD));
+    frameTimer.count("meshes drawn by gpu culling, shadow",
+                     Render::gpuDrawnMeshes(RenderPass::SHADOW));
+    frameTimer.count("meshes drawn by gpu culling, G-buffer",
+                     Render::gpuDrawnMeshes(RenderPass::GBUFFER));
+    frameTimer.count("record ms, shadow",
+                     Render::recordMilliseconds(RenderPass::SHADOW));
+    frameTimer.count("record ms, G-buffer",
+                     Render::recordMilliseconds(RenderPass::GBUFFER));
+    frameTimer.count("record ms, forward",
+                     Render::recordMilliseconds(RenderPass::FORWARD));
+    frameTimer.count("record jobs, shadow",
+                     Render::recordJobCount(RenderPass::SHADOW));
+    frameTimer.count("record jobs, G-buffer",
+                     Render::recordJobCount(RenderPass::GBUFFER));
+    frameTimer.count("G-buffer meshes occluded %",
+                     Render::occlusion().occludedPercent());
+    Render::endFrame();
+    frameTimer.end();
     displayManager.afterward();
     // poll IO events, eg. mouse moved etc.
     glfwPollEvents();
   }
 
+  textureUploader.cleanUp();
+  Render::cleanUp();
   scene.cleanUp();
   modelShader.cleanUp();
+  if (cullShader) {
+    cullShader->cleanUp();
+  }
   displayManager.destroy();
   glfwTerminate();
 
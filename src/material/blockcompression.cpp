@@ -0,0 +1,495 @@
+
+#include "blockcompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int BC7_WEIGHTS4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                              34, 38, 43, 47, 51, 55, 60, 64};
+
+int clampByte(float value) {
+  return std::min(255, std::max(0, int(value + 0.5f)));
+}
+
+// principal axis of the block colors, channels = 3 (rgb) or 4 (rgba)
+void principalAxis(const unsigned char block[64], int channels,
+                   float mean[4], float axis[4]) {
+  for (int c = 0; c < 4; ++c) {
+    mean[c] = 0.0f;
+    axis[c] = c < channels ? 1.0f : 0.0f;
+  }
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < channels; ++c) {
+      mean[c] += block[i * 4 + c] / 16.0f;
+    }
+  }
+  float cov[4][4] = {};
+  for (int i = 0; i < 16; ++i) {
+    float d[4];
+    for (int c = 0; c < channels; ++c) {
+      d[c] = block[i * 4 + c] - mean[c];
+    }
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        cov[a][b] += d[a] * d[b];
+      }
+    }
+  }
+  // power iteration converges fast enough for a 4x4 block
+  for (int iter = 0; iter < 8; ++iter) {
+    float next[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        next[a] += cov[a][b] * axis[b];
+      }
+    }
+    float length = 0.0f;
+    for (int c = 0; c < channels; ++c) {
+      length += next[c] * next[c];
+    }
+    if (length < 1e-8f) {
+      break;
+    }
+    length = std::sqrt(length);
+    for (int c = 0; c < channels; ++c) {
+      axis[c] = next[c] / length;
+    }
+  }
+}
+
+// endpoints as the extreme projections on the principal axis
+void axisEndpoints(const unsigned char block[64], int channels,
+                   float low[4], float high[4]) {
+  float mean[4], axis[4];
+  principalAxis(block, channels, mean, axis);
+  float minT = 0.0f, maxT = 0.0f;
+  for (int i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (int c = 0; c < channels; ++c) {
+      t += (block[i * 4 + c] - mean[c]) * axis[c];
+    }
+    minT = std::min(minT, t);
+    maxT = std::max(maxT, t);
+  }
+  for (int c = 0; c < 4; ++c) {
+    low[c] = mean[c] + minT * axis[c];
+    high[c] = mean[c] + maxT * axis[c];
+  }
+}
+
+unsigned short packRGB565(const float color[4]) {
+  int r = std::min(31, std::max(0, int(color[0] * 31.0f / 255.0f + 0.5f)));
+  int g = std::min(63, std::max(0, int(color[1] * 63.0f / 255.0f + 0.5f)));
+  int b = std::min(31, std::max(0, int(color[2] * 31.0f / 255.0f + 0.5f)));
+  return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(unsigned short packed, int color[4]) {
+  int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+  color[3] = 255;
+}
+
+void writeBits(unsigned char *out, int &pos, unsigned int value, int count) {
+  for (int i = 0; i < count; ++i, ++pos) {
+    if ((value >> i) & 1) {
+      out[pos >> 3] |= (unsigned char)(1 << (pos & 7));
+    }
+  }
+}
+
+unsigned int readBits(const unsigned char *in, int &pos, int count) {
+  unsigned int value = 0;
+  for (int i = 0; i < count; ++i, ++pos) {
+    value |= ((in[pos >> 3] >> (pos & 7)) & 1u) << i;
+  }
+  return value;
+}
+
+void fetchBlock(const unsigned char *rgba, int width, int height, int bx,
+                int by, unsigned char block[64]) {
+  for (int y = 0; y < 4; ++y) {
+    int sy = std::min(by * 4 + y, height - 1);
+    for (int x = 0; x < 4; ++x) {
+      int sx = std::min(bx * 4 + x, width - 1);
+      memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4,
+             4);
+    }
+  }
+}
+
+void storeBlock(const unsigned char block[64], int width, int height, int bx,
+                int by, unsigned char *rgba) {
+  for (int y = 0; y < 4 && by * 4 + y < height; ++y) {
+    for (int x = 0; x < 4 && bx * 4 + x < width; ++x) {
+      memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4,
+             block + (y * 4 + x) * 4, 4);
+    }
+  }
+}
+
+float srgbToLinear(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+} // namespace
+
+unsigned int BlockCompression::blockBytes(BlockFormat format) {
+  return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+}
+
+unsigned int BlockCompression::compressedSize(int width, int height,
+                                              BlockFormat format) {
+  return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+std::vector<unsigned char>
+BlockCompression::compress(const unsigned char *rgba, int width, int height,
+                           BlockFormat format) {
+  int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  unsigned int bytes = blockBytes(format);
+  std::vector<unsigned char> out(size_t(blocksX) * blocksY * bytes, 0);
+  unsigned char block[64];
+  for (int by = 0; by < blocksY; ++by) {
+    for (int bx = 0; bx < blocksX; ++bx) {
+      fetchBlock(rgba, width, height, bx, by, block);
+      unsigned char *dst = &out[(size_t(by) * blocksX + bx) * bytes];
+      switch (format) {
+      case BlockFormat::BC1:
+        encodeBC1(block, dst);
+        break;
+      case BlockFormat::BC4:
+        encodeBC4(block, 0, dst);
+        break;
+      case BlockFormat::BC5:
+        encodeBC4(block, 0, dst);
+        encodeBC4(block, 1, dst + 8);
+        break;
+      case BlockFormat::BC7:
+        encodeBC7(block, dst);
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+std::vector<unsigned char>
+BlockCompression::decompress(const unsigned char *blocks, int width,
+                             int height, BlockFormat format) {
+  int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  unsigned int bytes = blockBytes(format);
+  std::vector<unsigned char> out(size_t(width) * height * 4, 0);
+  unsigned char block[64];
+  for (int by = 0; by < blocksY; ++by) {
+    for (int bx = 0; bx < blocksX; ++bx) {
+      const unsigned char *src = blocks + (size_t(by) * blocksX + bx) * bytes;
+      // single/dual channel formats read back like GL does: (r, g, 0, 1)
+      for (int i = 0; i < 16; ++i) {
+        block[i * 4] = block[i * 4 + 1] = block[i * 4 + 2] = 0;
+        block[i * 4 + 3] = 255;
+      }
+      switch (format) {
+      case BlockFormat::BC1:
+        decodeBC1(src, block);
+        break;
+      case BlockFormat::BC4:
+        decodeBC4(src, 0, block);
+        break;
+      case BlockFormat::BC5:
+        decodeBC4(src, 0, block);
+        decodeBC4(src + 8, 1, block);
+        break;
+      case BlockFormat::BC7:
+        decodeBC7(src, block);
+        break;
+      }
+      storeBlock(block, width, height, bx, by, &out[0]);
+    }
+  }
+  return out;
+}
+
+std::vector<unsigned char>
+BlockCompression::downsample(const unsigned char *rgba, int width, int height,
+                             bool isSRGB, bool isNormal) {
+  int dstWidth = std::max(1, width / 2), dstHeight = std::max(1, height / 2);
+  std::vector<unsigned char> out(size_t(dstWidth) * dstHeight * 4);
+  for (int y = 0; y < dstHeight; ++y) {
+    for (int x = 0; x < dstWidth; ++x) {
+      float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (int dy = 0; dy < 2; ++dy) {
+        int sy = std::min(y * 2 + dy, height - 1);
+        for (int dx = 0; dx < 2; ++dx) {
+          int sx = std::min(x * 2 + dx, width - 1);
+          const unsigned char *texel = rgba + (size_t(sy) * width + sx) * 4;
+          for (int c = 0; c < 4; ++c) {
+            float value = texel[c] / 255.0f;
+            if (isSRGB && c < 3) {
+              value = srgbToLinear(value);
+            } else if (isNormal && c < 3) {
+              value = value * 2.0f - 1.0f;
+            }
+            sum[c] += value * 0.25f;
+          }
+        }
+      }
+      if (isNormal) {
+        float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] +
+                                 sum[2] * sum[2]);
+        for (int c = 0; c < 3; ++c) {
+          sum[c] = length > 1e-6f ? sum[c] / length : (c == 2 ? 1.0f : 0.0f);
+          sum[c] = sum[c] * 0.5f + 0.5f;
+        }
+      } else if (isSRGB) {
+        for (int c = 0; c < 3; ++c) {
+          sum[c] = linearToSrgb(sum[c]);
+        }
+      }
+      unsigned char *dst = &out[(size_t(y) * dstWidth + x) * 4];
+      for (int c = 0; c < 4; ++c) {
+        dst[c] = (unsigned char)clampByte(sum[c] * 255.0f);
+      }
+    }
+  }
+  return out;
+}
+
+void BlockCompression::encodeBC1(const unsigned char block[64],
+                                 unsigned char *out) {
+  float low[4], high[4];
+  axisEndpoints(block, 3, low, high);
+  unsigned short c0 = packRGB565(high), c1 = packRGB565(low);
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  unsigned int indices = 0;
+  if (c0 != c1) {
+    // c0 > c1 selects the opaque four color mode
+    int palette[4][4];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; ++i) {
+      int best = 0, bestError = 1 << 30;
+      for (int p = 0; p < 4; ++p) {
+        int error = 0;
+        for (int c = 0; c < 3; ++c) {
+          int d = block[i * 4 + c] - palette[p][c];
+          error += d * d;
+        }
+        if (error < bestError) {
+          bestError = error;
+          best = p;
+        }
+      }
+      indices |= (unsigned int)best << (i * 2);
+    }
+  }
+  for (int b = 0; b < 4; ++b) {
+    out[4 + b] = (indices >> (b * 8)) & 0xff;
+  }
+}
+
+void BlockCompression::encodeBC4(const unsigned char block[64], int channel,
+                                 unsigned char *out) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; ++i) {
+    a0 = std::max(a0, int(block[i * 4 + channel]));
+    a1 = std::min(a1, int(block[i * 4 + channel]));
+  }
+  out[0] = (unsigned char)a0;
+  out[1] = (unsigned char)a1;
+  int pos = 16;
+  if (a0 == a1) {
+    return;
+  }
+  // a0 > a1 selects the eight value mode
+  int palette[8] = {a0, a1};
+  for (int p = 2; p < 8; ++p) {
+    palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+  }
+  for (int i = 0; i < 16; ++i) {
+    int best = 0, bestError = 1 << 30;
+    for (int p = 0; p < 8; ++p) {
+      int error = std::abs(block[i * 4 + channel] - palette[p]);
+      if (error < bestError) {
+        bestError = error;
+        best = p;
+      }
+    }
+    writeBits(out, pos, best, 3);
+  }
+}
+
+void BlockCompression::encodeBC7(const unsigned char block[64],
+                                 unsigned char *out) {
+  float low[4], high[4];
+  axisEndpoints(block, 4, low, high);
+
+  // mode 6: 7 bit rgba endpoints plus one p-bit each
+  int quantized[2][4], pBits[2];
+  const float *ends[2] = {low, high};
+  for (int e = 0; e < 2; ++e) {
+    int bestError = 1 << 30;
+    for (int p = 0; p < 2; ++p) {
+      int error = 0, q[4];
+      for (int c = 0; c < 4; ++c) {
+        q[c] = std::min(127, std::max(0, int((ends[e][c] - p) / 2.0f + 0.5f)));
+        int d = int(ends[e][c] + 0.5f) - (q[c] * 2 + p);
+        error += d * d;
+      }
+      if (error < bestError) {
+        bestError = error;
+        pBits[e] = p;
+        memcpy(quantized[e], q, sizeof(q));
+      }
+    }
+  }
+
+  int endpoints[2][4];
+  for (int e = 0; e < 2; ++e) {
+    for (int c = 0; c < 4; ++c) {
+      endpoints[e][c] = quantized[e][c] * 2 + pBits[e];
+    }
+  }
+  int indices[16];
+  for (int i = 0; i < 16; ++i) {
+    int best = 0, bestError = 1 << 30;
+    for (int p = 0; p < 16; ++p) {
+      int error = 0;
+      for (int c = 0; c < 4; ++c) {
+        int value = ((64 - BC7_WEIGHTS4[p]) * endpoints[0][c] +
+                     BC7_WEIGHTS4[p] * endpoints[1][c] + 32) >>
+                    6;
+        int d = block[i * 4 + c] - value;
+        error += d * d;
+      }
+      if (error < bestError) {
+        bestError = error;
+        best = p;
+      }
+    }
+    indices[i] = best;
+  }
+  // the anchor index is stored with its top bit implied zero
+  if (indices[0] & 8) {
+    std::swap(quantized[0], quantized[1]);
+    std::swap(pBits[0], pBits[1]);
+    for (int i = 0; i < 16; ++i) {
+      indices[i] = 15 - indices[i];
+    }
+  }
+
+  memset(out, 0, 16);
+  int pos = 0;
+  writeBits(out, pos, 1 << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    writeBits(out, pos, quantized[0][c], 7);
+    writeBits(out, pos, quantized[1][c], 7);
+  }
+  writeBits(out, pos, pBits[0], 1);
+  writeBits(out, pos, pBits[1], 1);
+  writeBits(out, pos, indices[0], 3);
+  for (int i = 1; i < 16; ++i) {
+    writeBits(out, pos, indices[i], 4);
+  }
+}
+
+void BlockCompression::decodeBC1(const unsigned char *in,
+                                 unsigned char block[64]) {
+  unsigned short c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+  int palette[4][4];
+  unpackRGB565(c0, palette[0]);
+  unpackRGB565(c1, palette[1]);
+  for (int c = 0; c < 3; ++c) {
+    if (c0 > c1) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = c0 > c1 ? 255 : 0;
+  unsigned int indices = in[4] | (in[5] << 8) | (in[6] << 16) |
+                         ((unsigned int)in[7] << 24);
+  for (int i = 0; i < 16; ++i) {
+    int *color = palette[(indices >> (i * 2)) & 3];
+    for (int c = 0; c < 4; ++c) {
+      block[i * 4 + c] = (unsigned char)color[c];
+    }
+  }
+}
+
+void BlockCompression::decodeBC4(const unsigned char *in, int channel,
+                                 unsigned char block[64]) {
+  int a0 = in[0], a1 = in[1];
+  int palette[8] = {a0, a1};
+  if (a0 > a1) {
+    for (int p = 2; p < 8; ++p) {
+      palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+    }
+  } else {
+    for (int p = 2; p < 6; ++p) {
+      palette[p] = ((6 - p) * a0 + (p - 1) * a1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  int pos = 16;
+  for (int i = 0; i < 16; ++i) {
+    block[i * 4 + channel] = (unsigned char)palette[readBits(in, pos, 3)];
+  }
+}
+
+void BlockCompression::decodeBC7(const unsigned char *in,
+                                 unsigned char block[64]) {
+  int pos = 0;
+  if (readBits(in, pos, 7) != (1u << 6)) {
+    // other modes are never written by the baker
+    for (int i = 0; i < 16; ++i) {
+      block[i * 4] = 255;
+      block[i * 4 + 1] = 0;
+      block[i * 4 + 2] = 255;
+      block[i * 4 + 3] = 255;
+    }
+    return;
+  }
+  int endpoints[2][4];
+  for (int c = 0; c < 4; ++c) {
+    endpoints[0][c] = readBits(in, pos, 7) << 1;
+    endpoints[1][c] = readBits(in, pos, 7) << 1;
+  }
+  int p0 = readBits(in, pos, 1), p1 = readBits(in, pos, 1);
+  for (int c = 0; c < 4; ++c) {
+    endpoints[0][c] |= p0;
+    endpoints[1][c] |= p1;
+  }
+  for (int i = 0; i < 16; ++i) {
+    int weight = BC7_WEIGHTS4[readBits(in, pos, i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; ++c) {
+      block[i * 4 + c] = (unsigned char)(((64 - weight) * endpoints[0][c] +
+                                          weight * endpoints[1][c] + 32) >>
+                                         6);
+    }
+  }
+}
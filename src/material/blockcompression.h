@@ -0,0 +1,47 @@
+
+#ifndef OPENGL_BLOCKCOMPRESSION_H
+#define OPENGL_BLOCKCOMPRESSION_H
+
+#include <vector>
+
+/**
+ * cpu encoders/decoders for the 4x4 block formats used by baked textures.
+ * everything works on tightly packed RGBA8 images and needs no GL context,
+ * so the texture baker can verify a round trip offline.
+ *  - BC1: rgb, 8 bytes per block (diffuse without alpha)
+ *  - BC4: one channel, 8 bytes per block (specular/height/alpha masks)
+ *  - BC5: two channels, 16 bytes per block (tangent space normal xy)
+ *  - BC7: rgba, 16 bytes per block, only mode 6 is produced/decoded
+ */
+enum class BlockFormat { BC1, BC4, BC5, BC7 };
+
+class BlockCompression {
+public:
+  static unsigned int blockBytes(BlockFormat format);
+  static unsigned int compressedSize(int width, int height,
+                                     BlockFormat format);
+  // edge texels are repeated when the size is not a multiple of 4
+  static std::vector<unsigned char>
+  compress(const unsigned char *rgba, int width, int height,
+           BlockFormat format);
+  static std::vector<unsigned char>
+  decompress(const unsigned char *blocks, int width, int height,
+             BlockFormat format);
+  // 2x2 box filter to the next mip level, averaged in linear space for sRGB
+  // data and renormalized for normal maps
+  static std::vector<unsigned char> downsample(const unsigned char *rgba,
+                                               int width, int height,
+                                               bool isSRGB, bool isNormal);
+
+private:
+  static void encodeBC1(const unsigned char block[64], unsigned char *out);
+  static void encodeBC4(const unsigned char block[64], int channel,
+                        unsigned char *out);
+  static void encodeBC7(const unsigned char block[64], unsigned char *out);
+  static void decodeBC1(const unsigned char *in, unsigned char block[64]);
+  static void decodeBC4(const unsigned char *in, int channel,
+                        unsigned char block[64]);
+  static void decodeBC7(const unsigned char *in, unsigned char block[64]);
+};
+
+#endif // OPENGL_BLOCKCOMPRESSION_H
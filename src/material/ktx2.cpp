@@ -0,0 +1,254 @@
+
+#include "ktx2.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                           0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+// identifier + header + index, the level index follows
+const size_t KTX2_HEADER_SIZE = 80;
+const size_t KTX2_LEVEL_SIZE = 24;
+
+// data format descriptor values (Khronos Data Format Specification)
+const uint32_t KHR_DF_MODEL_BC1A = 128;
+const uint32_t KHR_DF_MODEL_BC4 = 131;
+const uint32_t KHR_DF_MODEL_BC5 = 132;
+const uint32_t KHR_DF_MODEL_BC7 = 134;
+const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+void put32(std::vector<unsigned char> &out, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[offset + i] = (value >> (i * 8)) & 0xff;
+  }
+}
+
+void put64(std::vector<unsigned char> &out, size_t offset, uint64_t value) {
+  put32(out, offset, uint32_t(value));
+  put32(out, offset + 4, uint32_t(value >> 32));
+}
+
+uint32_t get32(const std::vector<unsigned char> &in, size_t offset) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= uint32_t(in[offset + i]) << (i * 8);
+  }
+  return value;
+}
+
+uint64_t get64(const std::vector<unsigned char> &in, size_t offset) {
+  return get32(in, offset) | (uint64_t(get32(in, offset + 4)) << 32);
+}
+
+size_t alignTo(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// one basic descriptor block with a sample per stored channel
+std::vector<unsigned char> buildDFD(BlockFormat format, bool isSRGB) {
+  uint32_t model = KHR_DF_MODEL_BC1A;
+  int samples = 1;
+  switch (format) {
+  case BlockFormat::BC1:
+    model = KHR_DF_MODEL_BC1A;
+    break;
+  case BlockFormat::BC4:
+    model = KHR_DF_MODEL_BC4;
+    break;
+  case BlockFormat::BC5:
+    model = KHR_DF_MODEL_BC5;
+    samples = 2;
+    break;
+  case BlockFormat::BC7:
+    model = KHR_DF_MODEL_BC7;
+    break;
+  }
+  uint32_t blockBytes = BlockCompression::blockBytes(format);
+  uint32_t sampleBits = samples == 2 ? 64 : blockBytes * 8;
+  uint32_t blockSize = 24 + 16 * samples;
+
+  std::vector<unsigned char> dfd(4 + blockSize, 0);
+  put32(dfd, 0, dfd.size());
+  put32(dfd, 4, 0); // vendor khronos, descriptor type basic
+  put32(dfd, 8, 2 | (blockSize << 16));
+  put32(dfd, 12,
+        model | (KHR_DF_PRIMARIES_BT709 << 8) |
+            ((isSRGB ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+  put32(dfd, 16, 3 | (3 << 8)); // 4x4 texel blocks
+  put32(dfd, 20, blockBytes);
+  for (int s = 0; s < samples; ++s) {
+    size_t offset = 28 + 16 * s;
+    put32(dfd, offset,
+          (s * sampleBits) | ((sampleBits - 1) << 16) | (s << 24));
+    put32(dfd, offset + 12, 0xffffffffu);
+  }
+  return dfd;
+}
+
+} // namespace
+
+unsigned int Ktx2::vkFormat(BlockFormat format, bool isSRGB) {
+  switch (format) {
+  case BlockFormat::BC1:
+    return isSRGB ? VK_FORMAT_BC1_RGB_SRGB : VK_FORMAT_BC1_RGB_UNORM;
+  case BlockFormat::BC4:
+    return VK_FORMAT_BC4_UNORM;
+  case BlockFormat::BC5:
+    return VK_FORMAT_BC5_UNORM;
+  case BlockFormat::BC7:
+    return isSRGB ? VK_FORMAT_BC7_SRGB : VK_FORMAT_BC7_UNORM;
+  }
+  return 0;
+}
+
+bool Ktx2::blockFormat(unsigned int vkFormat, BlockFormat &format,
+                       bool &isSRGB) {
+  isSRGB =
+      (vkFormat == VK_FORMAT_BC1_RGB_SRGB || vkFormat == VK_FORMAT_BC7_SRGB);
+  switch (vkFormat) {
+  case VK_FORMAT_BC1_RGB_UNORM:
+  case VK_FORMAT_BC1_RGB_SRGB:
+    format = BlockFormat::BC1;
+    return true;
+  case VK_FORMAT_BC4_UNORM:
+    format = BlockFormat::BC4;
+    return true;
+  case VK_FORMAT_BC5_UNORM:
+    format = BlockFormat::BC5;
+    return true;
+  case VK_FORMAT_BC7_UNORM:
+  case VK_FORMAT_BC7_SRGB:
+    format = BlockFormat::BC7;
+    return true;
+  }
+  return false;
+}
+
+std::string Ktx2::bakedPath(const std::string &sourcePath) {
+  size_t dot = sourcePath.find_last_of('.');
+  size_t slash = sourcePath.find_last_of('/');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return sourcePath + ".ktx2";
+  }
+  return sourcePath.substr(0, dot) + ".ktx2";
+}
+
+bool Ktx2::write(const std::string &path, const Ktx2Image &image) {
+  BlockFormat format;
+  bool isSRGB;
+  if (!blockFormat(image.vkFormat, format, isSRGB) || image.levels.empty()) {
+    return false;
+  }
+  std::vector<unsigned char> dfd = buildDFD(format, isSRGB);
+  size_t levelCount = image.levels.size();
+  size_t dfdOffset = KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * levelCount;
+  size_t dataOffset = dfdOffset + dfd.size();
+
+  // mip data is stored smallest level first, each aligned to the block size
+  size_t alignment = BlockCompression::blockBytes(format);
+  std::vector<size_t> levelOffsets(levelCount);
+  for (size_t i = levelCount; i-- > 0;) {
+    dataOffset = alignTo(dataOffset, alignment);
+    levelOffsets[i] = dataOffset;
+    dataOffset += image.levels[i].size;
+  }
+
+  std::vector<unsigned char> out(dataOffset, 0);
+  memcpy(&out[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  put32(out, 12, image.vkFormat);
+  put32(out, 16, 1); // typeSize
+  put32(out, 20, image.width);
+  put32(out, 24, image.height);
+  put32(out, 28, 0); // pixelDepth
+  put32(out, 32, 0); // layerCount
+  put32(out, 36, 1); // faceCount
+  put32(out, 40, levelCount);
+  put32(out, 44, 0); // supercompressionScheme
+  put32(out, 48, dfdOffset);
+  put32(out, 52, dfd.size());
+  for (size_t i = 0; i < levelCount; ++i) {
+    const Ktx2Level &level = image.levels[i];
+    size_t entry = KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * i;
+    put64(out, entry, levelOffsets[i]);
+    put64(out, entry + 8, level.size);
+    put64(out, entry + 16, level.size);
+    memcpy(&out[levelOffsets[i]], &image.data[level.offset], level.size);
+  }
+  memcpy(&out[dfdOffset], dfd.data(), dfd.size());
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    std::cout << "ktx2 " << path << " open failed" << std::endl;
+    return false;
+  }
+  bool ok = fwrite(out.data(), out.size(), 1, file) == 1;
+  fclose(file);
+  return ok;
+}
+
+bool Ktx2::read(const std::string &path, Ktx2Image &image) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  std::vector<unsigned char> in;
+  fseek(file, 0, SEEK_END);
+  long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (fileSize > 0) {
+    in.resize(fileSize);
+    if (fread(&in[0], in.size(), 1, file) != 1) {
+      in.clear();
+    }
+  }
+  fclose(file);
+
+  BlockFormat format;
+  bool isSRGB;
+  if (in.size() < KTX2_HEADER_SIZE ||
+      memcmp(in.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+      !blockFormat(get32(in, 12), format, isSRGB) || get32(in, 28) > 1 ||
+      get32(in, 32) > 1 || get32(in, 36) != 1 || get32(in, 44) != 0) {
+    std::cout << "ktx2 " << path << " is not a supported 2d texture"
+              << std::endl;
+    return false;
+  }
+  image.vkFormat = get32(in, 12);
+  image.width = get32(in, 20);
+  image.height = get32(in, 24);
+  size_t levelCount = std::max<uint32_t>(1, get32(in, 40));
+  if (in.size() < KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * levelCount) {
+    return false;
+  }
+
+  // repack largest level first, so mip i can be uploaded at levels[i].offset
+  image.levels.clear();
+  image.data.clear();
+  for (size_t i = 0; i < levelCount; ++i) {
+    size_t entry = KTX2_HEADER_SIZE + KTX2_LEVEL_SIZE * i;
+    uint64_t offset = get64(in, entry), size = get64(in, entry + 8);
+    Ktx2Level level;
+    level.width = std::max(1, image.width >> i);
+    level.height = std::max(1, image.height >> i);
+    level.offset = image.data.size();
+    level.size = size;
+    if (offset + size > in.size() ||
+        size != BlockCompression::compressedSize(level.width, level.height,
+                                                 format)) {
+      std::cout << "ktx2 " << path << " level " << i << " is truncated"
+                << std::endl;
+      return false;
+    }
+    image.data.insert(image.data.end(), in.begin() + offset,
+                      in.begin() + offset + size);
+    image.levels.push_back(level);
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+
+#ifndef OPENGL_KTX2_H
+#define OPENGL_KTX2_H
+
+#include "blockcompression.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// the VkFormat values of the block formats the baker writes
+constexpr unsigned int VK_FORMAT_BC1_RGB_UNORM = 131;
+constexpr unsigned int VK_FORMAT_BC1_RGB_SRGB = 132;
+constexpr unsigned int VK_FORMAT_BC4_UNORM = 139;
+constexpr unsigned int VK_FORMAT_BC5_UNORM = 141;
+constexpr unsigned int VK_FORMAT_BC7_UNORM = 145;
+constexpr unsigned int VK_FORMAT_BC7_SRGB = 146;
+
+struct Ktx2Level {
+  // into Ktx2Image::data
+  size_t offset;
+  size_t size;
+  int width;
+  int height;
+};
+
+// a 2d block compressed texture with its full mip chain, level 0 first
+struct Ktx2Image {
+  unsigned int vkFormat = 0;
+  int width = 0;
+  int height = 0;
+  std::vector<Ktx2Level> levels;
+  std::vector<unsigned char> data;
+};
+
+/**
+ * minimal KTX2 container io: single 2d image, no supercompression, no
+ * key/value data. enough to round trip what the texture baker produces.
+ */
+class Ktx2 {
+public:
+  static bool write(const std::string &path, const Ktx2Image &image);
+  static bool read(const std::string &path, Ktx2Image &image);
+  // where the baker puts the compressed version of a source image
+  static std::string bakedPath(const std::string &sourcePath);
+  static unsigned int vkFormat(BlockFormat format, bool isSRGB);
+  static bool blockFormat(unsigned int vkFormat, BlockFormat &format,
+                          bool &isSRGB);
+};
+
+#endif // OPENGL_KTX2_H
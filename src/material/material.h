@@ -10,14 +10,21 @@
 #include <string>
 #include <vector>
 
+class CommandList;
+
 class Material {
 public:
   Material() = default;
   ~Material() = default;
   Material(const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess,
            const std::vector<Texture> &textures);
-  void configure(ShaderProgram &shaderProgram, int materialIndex,
-                 int textureIndex);
+  // selects this material's MaterialTable entry and binds its textures to
+  // the fixed material texture units, as commands: no GL calls, safe on
+  // worker threads. textures still streaming in bind a 1x1 fallback when
+  // the list is executed
+  void record(CommandList &commandList);
+  // drops this material's references in the texture registry
+  void cleanUp();
   glm::vec3 diffuse;
   glm::vec3 specular;
   float shininess;
@@ -27,6 +34,10 @@ public:
   bool hasSpecularTex = false;
   bool hasNormalMap = false;
   bool hasDepthMap = false;
+  // entry in MaterialTable, assigned when the owning mesh is uploaded
+  unsigned int tableIndex = 0;
+  // MaterialTable::addTextureSet id, used to group draws by their textures
+  unsigned int textureSetIndex = 0;
 };
 
 #endif // OPENGL_MATERIAL_H
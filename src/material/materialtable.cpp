@@ -0,0 +1,127 @@
+
+#include "materialtable.h"
+#include "../renderengine/gldebug.h"
+#include "../renderengine/shader.h"
+#include "material.h"
+#include <cstring>
+
+std::vector<MaterialParams> MaterialTable::entries;
+std::map<MaterialParams, unsigned int, MaterialTable::ParamsLess>
+    MaterialTable::lookup;
+std::map<std::vector<std::string>, unsigned int> MaterialTable::textureSets;
+GLuint MaterialTable::UBO = 0;
+size_t MaterialTable::uploadedSize = 0;
+GLsizeiptr MaterialTable::pageStride = 0;
+int MaterialTable::boundPage = -1;
+
+bool MaterialTable::ParamsLess::operator()(const MaterialParams &a,
+                                           const MaterialParams &b) const {
+  // only floats and ints, there is no padding to compare
+  return memcmp(&a, &b, sizeof(MaterialParams)) < 0;
+}
+
+unsigned int MaterialTable::add(const Material &material) {
+  MaterialParams params;
+  params.diffuseShininess = glm::vec4(material.diffuse, material.shininess);
+  params.specularColor = glm::vec4(material.specular, 0.0f);
+  params.textureFlags[0] = material.hasDiffuseTex;
+  params.textureFlags[1] = material.hasSpecularTex;
+  params.textureFlags[2] = material.hasNormalMap;
+  params.textureFlags[3] = material.hasDepthMap;
+
+  std::map<MaterialParams, unsigned int, ParamsLess>::iterator it =
+      lookup.find(params);
+  if (it != lookup.end()) {
+    return it->second;
+  }
+  unsigned int index = entries.size();
+  entries.push_back(params);
+  lookup[params] = index;
+  return index;
+}
+
+unsigned int MaterialTable::addTextureSet(const Material &material) {
+  if (material.textures.empty()) {
+    return 0;
+  }
+  // one file is one texture object, see TextureRegistry
+  std::vector<std::string> files(TEXTURE_UNIT_NUM);
+  for (const Texture &texture : material.textures) {
+    files[(int)texture.getType()] = texture.getFileName();
+  }
+  std::map<std::vector<std::string>, unsigned int>::iterator it =
+      textureSets.find(files);
+  if (it != textureSets.end()) {
+    return it->second;
+  }
+  unsigned int index = textureSets.size() + 1;
+  textureSets[files] = index;
+  return index;
+}
+
+int MaterialTable::use(unsigned int index) {
+  if (uploadedSize != entries.size()) {
+    upload();
+  }
+  int page = index / PAGE_SIZE;
+  if (page != boundPage) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, UBO, page * pageStride,
+                      PAGE_SIZE * sizeof(MaterialParams));
+    boundPage = page;
+  }
+  return index % PAGE_SIZE;
+}
+
+void MaterialTable::upload() {
+  if (pageStride == 0) {
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    GLsizeiptr pageBytes = PAGE_SIZE * sizeof(MaterialParams);
+    pageStride = (pageBytes + alignment - 1) / alignment * alignment;
+  }
+  // every page is allocated in full, the block always has PAGE_SIZE entries
+  size_t pageNum = (entries.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+  std::vector<unsigned char> staging(pageNum * pageStride, 0);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    memcpy(&staging[(i / PAGE_SIZE) * pageStride +
+                    (i % PAGE_SIZE) * sizeof(MaterialParams)],
+           &entries[i], sizeof(MaterialParams));
+  }
+  if (UBO == 0) {
+    glGenBuffers(1, &UBO);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(),
+               GL_STATIC_DRAW);
+  GLDebug::label(GL_BUFFER, UBO, "material table");
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  uploadedSize = entries.size();
+  boundPage = -1;
+}
+
+void MaterialTable::configure(ShaderProgram &shaderProgram) {
+  shaderProgram.use();
+  shaderProgram.bindUniformBlock("MaterialTable", BINDING);
+  // same order as Texture::TextureType
+  const char *samplers[] = {"materialTextures.diffuse",
+                            "materialTextures.specular",
+                            "materialTextures.normal",
+                            "materialTextures.depth"};
+  for (int t = 0; t < TEXTURE_UNIT_NUM; ++t) {
+    shaderProgram.uniformSetInt(samplers[t], TEXTURE_UNIT + t);
+  }
+}
+
+void MaterialTable::cleanUp() {
+  if (UBO) {
+    glDeleteBuffers(1, &UBO);
+    UBO = 0;
+  }
+  entries.clear();
+  lookup.clear();
+  textureSets.clear();
+  uploadedSize = 0;
+  boundPage = -1;
+}
+
+size_t MaterialTable::size() { return entries.size(); }
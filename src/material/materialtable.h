@@ -0,0 +1,72 @@
+
+#ifndef OPENGL_MATERIALTABLE_H
+#define OPENGL_MATERIALTABLE_H
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+class Material;
+class ShaderProgram;
+
+// one entry of the MaterialTable uniform block, std140 layout
+struct MaterialParams {
+  glm::vec4 diffuseShininess; // rgb diffuse color, a shininess
+  glm::vec4 specularColor;
+  // hasDiffuseTex, hasSpecularTex, hasNormalMap, hasDepthMap
+  GLint textureFlags[4];
+};
+
+/**
+ * the parameters of every loaded material, packed into one std140 uniform
+ * buffer when they are first drawn. identical materials share an entry, so
+ * a draw only sets its index and binds its textures.
+ * the shaders see PAGE_SIZE entries at a time; bigger tables are split into
+ * pages and the page holding the drawn material is bound on demand.
+ * GL thread only.
+ */
+class MaterialTable {
+public:
+  // must match MATERIAL_TABLE_SIZE in the shaders
+  static const unsigned int PAGE_SIZE = 256;
+  // uniform buffer binding point, Matrices uses 0
+  static const GLuint BINDING = 1;
+  // first texture unit of the material textures, one unit per texture type
+  static const int TEXTURE_UNIT = 0;
+  static const int TEXTURE_UNIT_NUM = 4;
+
+  // returns the entry index of the material's parameters
+  static unsigned int add(const Material &material);
+  // id of the textures a material binds, materials binding the same files
+  // share it. 0 is the set without textures
+  static unsigned int addTextureSet(const Material &material);
+  // uploads pending entries, binds the page holding index and returns the
+  // index within that page
+  static int use(unsigned int index);
+  // binds the MaterialTable block and the material samplers of a program to
+  // their fixed slots, once after it is created
+  static void configure(ShaderProgram &shaderProgram);
+  static void cleanUp();
+  static size_t size();
+
+private:
+  struct ParamsLess {
+    bool operator()(const MaterialParams &a, const MaterialParams &b) const;
+  };
+
+  static void upload();
+
+  static std::vector<MaterialParams> entries;
+  static std::map<MaterialParams, unsigned int, ParamsLess> lookup;
+  static std::map<std::vector<std::string>, unsigned int> textureSets;
+  static GLuint UBO;
+  // entries already in UBO
+  static size_t uploadedSize;
+  // byte distance between pages, respects the offset alignment
+  static GLsizeiptr pageStride;
+  static int boundPage;
+};
+
+#endif // OPENGL_MATERIALTABLE_H
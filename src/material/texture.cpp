@@ -1,41 +1,122 @@
 
 #include "texture.h"
+#include "../renderengine/glstate.h"
 #include "../renderengine/stb_image.h"
 #include <iostream>
+#include <vector>
 
-Texture::Texture() { textureObj = 0; }
+// s3tc and bptc are not part of the 3.3 core profile glad was generated for
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+static GLuint fallbackTextures[4] = {0, 0, 0, 0};
+
+static GLenum compressedInternalFormat(unsigned int vkFormat) {
+  switch (vkFormat) {
+  case VK_FORMAT_BC1_RGB_UNORM:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case VK_FORMAT_BC1_RGB_SRGB:
+    return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+  case VK_FORMAT_BC4_UNORM:
+    return GL_COMPRESSED_RED_RGTC1;
+  case VK_FORMAT_BC5_UNORM:
+    return GL_COMPRESSED_RG_RGTC2;
+  case VK_FORMAT_BC7_UNORM:
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  case VK_FORMAT_BC7_SRGB:
+    return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+  }
+  return 0;
+}
+
+Texture::Texture() : textureObj(std::make_shared<GLuint>(0)) {}
 
 Texture::~Texture() {}
 
-void Texture::cleanUp() { glDeleteTextures(1, &textureObj); }
+void Texture::cleanUp() {
+  if (*textureObj != 0) {
+    GLState::deleteTextures(1, textureObj.get());
+    *textureObj = 0;
+  }
+}
 
 Texture::Texture(GLenum textureTarget, const std::string &fileName,
                  TextureType &textureType)
-    : textureTarget(textureTarget), fileName(fileName), type(textureType) {}
+    : textureTarget(textureTarget), textureObj(std::make_shared<GLuint>(0)),
+      fileName(fileName), type(textureType) {}
+
+bool ImageData::isBaked() const { return !baked.levels.empty(); }
+
+size_t ImageData::byteSize() const {
+  return isBaked() ? baked.data.size()
+                   : size_t(width) * height * components;
+}
+
+const unsigned char *ImageData::bytes() const {
+  return isBaked() ? baked.data.data() : pixels;
+}
+
+void ImageData::free() {
+  if (pixels) {
+    stbi_image_free(pixels);
+    pixels = nullptr;
+  }
+  baked = Ktx2Image();
+}
 
 bool Texture::load() {
-  int width, height, nrComponents;
-  unsigned char *data =
-      stbi_load(fileName.c_str(), &width, &height, &nrComponents, 0);
+  ImageData image = decode(fileName);
+  return upload(image);
+}
+
+ImageData Texture::decode(const std::string &fileName) {
+  ImageData image;
+  // the baked version already carries its compressed mip chain
+  if (Ktx2::read(Ktx2::bakedPath(fileName), image.baked)) {
+    image.width = image.baked.width;
+    image.height = image.baked.height;
+    return image;
+  }
+  image.pixels = stbi_load(fileName.c_str(), &image.width, &image.height,
+                           &image.components, 0);
+  return image;
+}
+
+bool Texture::upload(ImageData &image, bool fromUnpackBuffer) {
+  if (image.isBaked()) {
+    return uploadBaked(image, fromUnpackBuffer);
+  }
   bool isDiffuse = (type == TextureType::DIFFUSE);
-  if (data) {
+  if (image.pixels) {
     GLenum format;
     GLenum internalFormat;
-    if (nrComponents == 1) {
+    if (image.components == 1) {
       format = GL_RED;
       internalFormat = GL_RED;
-    } else if (nrComponents == 3) {
+    } else if (image.components == 3) {
       format = GL_RGB;
-      internalFormat = isDiffuse ? GL_SRGB : GL_RGB16F;
-    } else if (nrComponents == 4) {
+      internalFormat = isDiffuse ? GL_SRGB : GL_RGB8;
+    } else if (image.components == 4) {
       format = GL_RGBA;
-      internalFormat = isDiffuse ? GL_SRGB_ALPHA : GL_RGBA16F;
+      internalFormat = isDiffuse ? GL_SRGB_ALPHA : GL_RGBA8;
     }
 
-    glGenTextures(1, &textureObj);
-    glBindTexture(textureTarget, textureObj);
-    glTexImage2D(textureTarget, 0, internalFormat, width, height, 0, format,
-                 GL_UNSIGNED_BYTE, data);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::bindTexture(textureTarget, texture);
+    glTexImage2D(textureTarget, 0, internalFormat, image.width, image.height,
+                 0, format, GL_UNSIGNED_BYTE,
+                 fromUnpackBuffer ? nullptr : image.pixels);
     glGenerateMipmap(textureTarget);
 
     glTexParameteri(textureTarget, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -43,22 +124,131 @@ bool Texture::load() {
     glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER,
                     GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(textureTarget, 0);
+    GLState::bindTexture(textureTarget, 0);
+    *textureObj = texture;
 
-    stbi_image_free(data);
+    image.free();
     return true;
   } else {
     std::cout << "Texture failed to load at path: " << fileName << std::endl;
-    stbi_image_free(data);
+    image.free();
     return false;
   }
 }
 
+bool Texture::uploadBaked(ImageData &image, bool fromUnpackBuffer) {
+  const Ktx2Image &baked = image.baked;
+  GLenum internalFormat = compressedInternalFormat(baked.vkFormat);
+  BlockFormat blockFormat;
+  bool isSRGB;
+  Ktx2::blockFormat(baked.vkFormat, blockFormat, isSRGB);
+  bool isSupported = isCompressedFormatSupported(internalFormat);
+  if (!isSupported && fromUnpackBuffer) {
+    // decompressed below from the cpu copy instead
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  GLState::bindTexture(textureTarget, texture);
+  for (size_t i = 0; i < baked.levels.size(); ++i) {
+    const Ktx2Level &level = baked.levels[i];
+    if (isSupported) {
+      const void *data = fromUnpackBuffer
+                             ? reinterpret_cast<const void *>(level.offset)
+                             : &baked.data[level.offset];
+      glCompressedTexImage2D(textureTarget, i, internalFormat, level.width,
+                             level.height, 0, level.size, data);
+    } else {
+      // the driver lacks the format, keep the baked mips but store them raw
+      std::vector<unsigned char> rgba = BlockCompression::decompress(
+          &baked.data[level.offset], level.width, level.height, blockFormat);
+      glTexImage2D(textureTarget, i, isSRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8,
+                   level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   rgba.data());
+    }
+  }
+  glTexParameteri(textureTarget, GL_TEXTURE_MAX_LEVEL,
+                  baked.levels.size() - 1);
+  if (blockFormat == BlockFormat::BC4) {
+    // masks are sampled as rgb, replicate the single channel
+    glTexParameteri(textureTarget, GL_TEXTURE_SWIZZLE_G, GL_RED);
+    glTexParameteri(textureTarget, GL_TEXTURE_SWIZZLE_B, GL_RED);
+  }
+
+  glTexParameteri(textureTarget, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(textureTarget, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GLState::bindTexture(textureTarget, 0);
+  *textureObj = texture;
+
+  image.free();
+  return true;
+}
+
+bool Texture::isCompressedFormatSupported(GLenum format) {
+  // rgtc is core since 3.0, the others depend on the driver
+  if (format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RG_RGTC2) {
+    return true;
+  }
+  static std::vector<GLint> formats;
+  static bool queried = false;
+  if (!queried) {
+    queried = true;
+    GLint formatNum = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatNum);
+    formats.resize(formatNum);
+    if (formatNum > 0) {
+      glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+    }
+  }
+  for (GLint supported : formats) {
+    if (GLenum(supported) == format) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Texture::bind(GLenum textureUnit) {
-  glActiveTexture(textureUnit);
-  glBindTexture(textureTarget, textureObj);
+  GLState::bindTexture(textureUnit - GL_TEXTURE0, textureTarget,
+                       isResident() ? *textureObj : fallbackTexture(type));
+}
+
+bool Texture::isResident() const { return *textureObj != 0; }
+
+GLuint Texture::fallbackTexture(TextureType type) {
+  GLuint &texture = fallbackTextures[(int)type];
+  if (texture == 0) {
+    // white albedo, no specular, flat tangent space normal, zero height
+    const unsigned char colors[4][3] = {
+        {255, 255, 255}, {0, 0, 0}, {128, 128, 255}, {0, 0, 0}};
+    glGenTextures(1, &texture);
+    GLState::bindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 colors[(int)type]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+  }
+  return texture;
 }
 
+void Texture::cleanUpFallbacks() {
+  for (GLuint &texture : fallbackTextures) {
+    if (texture != 0) {
+      GLState::deleteTextures(1, &texture);
+      texture = 0;
+    }
+  }
+}
+
+const std::string &Texture::getFileName() const { return fileName; }
+
+Texture::TextureType Texture::getType() const { return type; }
+
 std::string Texture::TexTypeToString() {
   std::string table[] = {"diffuse", "specular", "normal", "depth"};
   return table[(int)type];
@@ -2,9 +2,26 @@
 #ifndef OPENGL_TEXTURE_H
 #define OPENGL_TEXTURE_H
 
+#include "ktx2.h"
 #include <glad/glad.h>
+#include <memory>
 #include <string>
 
+// decoded pixels waiting for upload, owned until Texture::upload frees them
+struct ImageData {
+  unsigned char *pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  int components = 0;
+  // set instead of pixels when an offline baked .ktx2 was found
+  Ktx2Image baked;
+  bool isBaked() const;
+  // what has to reach the GPU, all mip levels for baked images
+  size_t byteSize() const;
+  const unsigned char *bytes() const;
+  void free();
+};
+
 class Texture {
 public:
   Texture();
@@ -13,13 +30,28 @@ public:
   Texture(GLenum textureTarget, const std::string &fileName,
           TextureType &textureType);
   bool load();
+  // cpu only, safe to run on worker threads. prefers a baked sibling .ktx2
+  static ImageData decode(const std::string &fileName);
+  // needs the GL context, takes ownership of the image pixels. with
+  // fromUnpackBuffer the pixels are read from the bound GL_PIXEL_UNPACK_BUFFER
+  bool upload(ImageData &image, bool fromUnpackBuffer = false);
+  // binds a 1x1 fallback until the texture is resident
   void bind(GLenum textureUnit);
+  bool isResident() const;
   std::string TexTypeToString();
   void cleanUp();
+  const std::string &getFileName() const;
+  TextureType getType() const;
+  static GLuint fallbackTexture(TextureType type);
+  static void cleanUpFallbacks();
+  static bool isCompressedFormatSupported(GLenum format);
 
 private:
+  bool uploadBaked(ImageData &image, bool fromUnpackBuffer);
+
   GLenum textureTarget;
-  GLuint textureObj;
+  // shared by every copy handed out to materials, 0 until uploaded
+  std::shared_ptr<GLuint> textureObj;
   std::string fileName;
   TextureType type;
 };
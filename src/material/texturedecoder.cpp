@@ -0,0 +1,54 @@
+
+#include "texturedecoder.h"
+#include <chrono>
+
+TextureDecoder::TextureDecoder(unsigned int threadNum) : pool(threadNum) {}
+
+TextureDecoder::~TextureDecoder() {
+  // free images nobody collected
+  for (std::map<std::string, std::future<ImageData>>::iterator it =
+           pending.begin();
+       it != pending.end(); ++it) {
+    it->second.get().free();
+  }
+}
+
+void TextureDecoder::request(const std::string &fileName) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pending.count(fileName)) {
+    return;
+  }
+  pending[fileName] =
+      pool.submit([fileName]() { return Texture::decode(fileName); });
+}
+
+ImageData TextureDecoder::collect(const std::string &fileName) {
+  std::future<ImageData> future;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, std::future<ImageData>>::iterator it =
+        pending.find(fileName);
+    if (it == pending.end()) {
+      return Texture::decode(fileName);
+    }
+    future = std::move(it->second);
+    pending.erase(it);
+  }
+  return future.get();
+}
+
+bool TextureDecoder::tryCollect(const std::string &fileName,
+                                ImageData &image) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<std::string, std::future<ImageData>>::iterator it =
+      pending.find(fileName);
+  if (it == pending.end() || it->second.wait_for(std::chrono::seconds(0)) !=
+                                 std::future_status::ready) {
+    return false;
+  }
+  image = it->second.get();
+  pending.erase(it);
+  return true;
+}
+
+unsigned int TextureDecoder::threadNum() const { return pool.size(); }
@@ -0,0 +1,34 @@
+
+#ifndef OPENGL_TEXTUREDECODER_H
+#define OPENGL_TEXTUREDECODER_H
+
+#include "../utils/threadpool.h"
+#include "texture.h"
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * decodes image files on worker threads while the model is still being
+ * processed; the GL thread collects the pixels afterwards and uploads them.
+ */
+class TextureDecoder {
+public:
+  explicit TextureDecoder(unsigned int threadNum = 0);
+  ~TextureDecoder();
+  // queue a decode job, a file that is already queued is not decoded twice
+  void request(const std::string &fileName);
+  // blocks until the file is decoded, the caller owns the returned pixels
+  ImageData collect(const std::string &fileName);
+  // non-blocking collect, false while the file is still being decoded
+  bool tryCollect(const std::string &fileName, ImageData &image);
+  unsigned int threadNum() const;
+
+private:
+  ThreadPool pool;
+  std::mutex mutex;
+  std::map<std::string, std::future<ImageData>> pending;
+};
+
+#endif // OPENGL_TEXTUREDECODER_H
@@ -0,0 +1,49 @@
+
+#include "textureregistry.h"
+#include "../utils/fileutils.h"
+
+std::map<TextureRegistry::Key, TextureRegistry::Entry>
+    TextureRegistry::textures;
+std::mutex TextureRegistry::mutex;
+
+Texture TextureRegistry::acquire(const std::string &fileName,
+                                 Texture::TextureType type, bool &created) {
+  Key key(FileUtils::canonicalPath(fileName), type);
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<Key, Entry>::iterator it = textures.find(key);
+  created = (it == textures.end());
+  if (created) {
+    Entry entry = {Texture(GL_TEXTURE_2D, fileName, type), 0};
+    it = textures.insert(std::make_pair(key, entry)).first;
+  }
+  ++it->second.refCount;
+  return it->second.texture;
+}
+
+void TextureRegistry::release(const Texture &texture) {
+  Key key(FileUtils::canonicalPath(texture.getFileName()), texture.getType());
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<Key, Entry>::iterator it = textures.find(key);
+  if (it == textures.end()) {
+    return;
+  }
+  if (--it->second.refCount == 0) {
+    it->second.texture.cleanUp();
+    textures.erase(it);
+  }
+}
+
+void TextureRegistry::cleanUp() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::map<Key, Entry>::iterator it = textures.begin();
+       it != textures.end(); ++it) {
+    it->second.texture.cleanUp();
+  }
+  textures.clear();
+  Texture::cleanUpFallbacks();
+}
+
+size_t TextureRegistry::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return textures.size();
+}
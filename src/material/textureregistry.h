@@ -0,0 +1,40 @@
+
+#ifndef OPENGL_TEXTUREREGISTRY_H
+#define OPENGL_TEXTUREREGISTRY_H
+
+#include "texture.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * one texture per file and type for the whole process, keyed by canonical
+ * path and TextureType and reference counted by the materials using it. the
+ * type picks the sampler unit and the internal format (sRGB for diffuse), so
+ * a file used as diffuse and as specular is two textures. the GL object is
+ * deleted when the last material releases it.
+ */
+class TextureRegistry {
+public:
+  // takes a reference; created is true when the caller has to load it
+  static Texture acquire(const std::string &fileName,
+                         Texture::TextureType type, bool &created);
+  static void release(const Texture &texture);
+  // deletes everything still registered, for shutdown
+  static void cleanUp();
+  static size_t size();
+
+private:
+  struct Entry {
+    Texture texture;
+    unsigned int refCount;
+  };
+
+  typedef std::pair<std::string, Texture::TextureType> Key;
+
+  static std::map<Key, Entry> textures;
+  static std::mutex mutex;
+};
+
+#endif // OPENGL_TEXTUREREGISTRY_H
@@ -0,0 +1,70 @@
+
+#include "textureuploader.h"
+#include <cstring>
+
+TextureUploader::TextureUploader(size_t bytesPerFrame)
+    : bytesPerFrame(bytesPerFrame) {
+  glGenBuffers(PBO_RING_SIZE, pixelBuffers);
+}
+
+void TextureUploader::enqueue(const Texture &texture) {
+  decoder.request(texture.getFileName());
+  pending.push_back(PendingTexture{texture, ImageData(), false});
+}
+
+void TextureUploader::update() {
+  size_t uploaded = 0;
+  std::deque<PendingTexture>::iterator it = pending.begin();
+  while (it != pending.end()) {
+    if (!it->decoded) {
+      it->decoded = decoder.tryCollect(it->texture.getFileName(), it->image);
+      if (!it->decoded) {
+        ++it;
+        continue;
+      }
+    }
+
+    ImageData &image = it->image;
+    size_t size = image.byteSize();
+    // always let one texture through, so an image larger than the budget
+    // cannot block the queue forever
+    if (uploaded > 0 && uploaded + size > bytesPerFrame) {
+      break;
+    }
+
+    if (image.bytes()) {
+      GLuint pixelBuffer = pixelBuffers[nextBuffer];
+      nextBuffer = (nextBuffer + 1) % PBO_RING_SIZE;
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+      // orphan the old storage so we never wait on a transfer still in flight
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+      void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                   GL_MAP_WRITE_BIT |
+                                       GL_MAP_INVALIDATE_BUFFER_BIT);
+      if (dst) {
+        memcpy(dst, image.bytes(), size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        it->texture.upload(image, true);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        it->texture.upload(image);
+      }
+    } else {
+      // reports the failed decode
+      it->texture.upload(image);
+    }
+    uploaded += size;
+    it = pending.erase(it);
+  }
+}
+
+bool TextureUploader::idle() const { return pending.empty(); }
+
+void TextureUploader::cleanUp() {
+  for (PendingTexture &texture : pending) {
+    texture.image.free();
+  }
+  pending.clear();
+  glDeleteBuffers(PBO_RING_SIZE, pixelBuffers);
+}
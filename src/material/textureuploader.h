@@ -0,0 +1,49 @@
+
+#ifndef OPENGL_TEXTUREUPLOADER_H
+#define OPENGL_TEXTUREUPLOADER_H
+
+#include "texture.h"
+#include "texturedecoder.h"
+#include <cstddef>
+#include <deque>
+#include <glad/glad.h>
+#include <vector>
+
+constexpr unsigned int PBO_RING_SIZE = 4;
+
+/**
+ * streams textures to the GPU in the background: files are decoded on the
+ * decoder's worker threads, then update() copies at most bytesPerFrame of
+ * decoded pixels per frame through a ring of pixel buffer objects.
+ * until then Texture::bind falls back to a 1x1 texture.
+ */
+class TextureUploader {
+public:
+  explicit TextureUploader(size_t bytesPerFrame);
+  ~TextureUploader() = default;
+  TextureUploader(const TextureUploader &) = delete;
+  TextureUploader &operator=(const TextureUploader &) = delete;
+  // texture shares its GL object with every copy, so materials holding one
+  // see it become resident
+  void enqueue(const Texture &texture);
+  // call once per frame on the GL thread
+  void update();
+  bool idle() const;
+  void cleanUp();
+
+  size_t bytesPerFrame;
+
+private:
+  struct PendingTexture {
+    Texture texture;
+    ImageData image;
+    bool decoded;
+  };
+
+  TextureDecoder decoder;
+  std::deque<PendingTexture> pending;
+  GLuint pixelBuffers[PBO_RING_SIZE];
+  unsigned int nextBuffer = 0;
+};
+
+#endif // OPENGL_TEXTUREUPLOADER_H
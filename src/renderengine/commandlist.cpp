@@ -0,0 +1,159 @@
+#include "commandlist.h"
+#include "../material/materialtable.h"
+#include "../material/texture.h"
+#include "glstate.h"
+
+void CommandList::clear() {
+  commands.clear();
+  records.clear();
+  drawCommands.clear();
+  indirectDraws.clear();
+}
+
+void CommandList::useProgram(ShaderProgram *program) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::USE_PROGRAM;
+  command.program = program;
+  commands.push_back(command);
+}
+
+void CommandList::bindGeometry() {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::BIND_GEOMETRY;
+  commands.push_back(command);
+}
+
+void CommandList::bindTexture(int unit, GLenum target, GLuint texture) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::BIND_TEXTURE;
+  command.slot = unit;
+  command.target = target;
+  command.name = texture;
+  commands.push_back(command);
+}
+
+void CommandList::bindTexture(int unit, Texture *texture) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::BIND_MATERIAL_TEXTURE;
+  command.slot = unit;
+  command.texture = texture;
+  commands.push_back(command);
+}
+
+void CommandList::setMaterial(UniformID id, unsigned int tableIndex) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::SET_MATERIAL;
+  command.slot = id;
+  command.value = tableIndex;
+  commands.push_back(command);
+}
+
+void CommandList::setInt(UniformID id, int value) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::SET_INT;
+  command.slot = id;
+  command.value = value;
+  commands.push_back(command);
+}
+
+GLuint CommandList::addRecord(const DrawRecord &record) {
+  records.push_back(record);
+  return records.size() - 1;
+}
+
+void CommandList::draw(const DrawElementsIndirectCommand &drawCommand) {
+  drawCommands.push_back(drawCommand);
+  if (!commands.empty() && commands.back().type == RenderCommand::DRAW) {
+    ++commands.back().count;
+    return;
+  }
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::DRAW;
+  command.first = drawCommands.size() - 1;
+  command.count = 1;
+  commands.push_back(command);
+}
+
+void CommandList::bindRecords(GLuint buffer) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::BIND_RECORDS;
+  command.name = buffer;
+  commands.push_back(command);
+}
+
+void CommandList::drawIndirectCount(const IndirectCountDraw &indirectDraw) {
+  RenderCommand command = RenderCommand();
+  command.type = RenderCommand::DRAW_INDIRECT_COUNT;
+  command.first = indirectDraws.size();
+  indirectDraws.push_back(indirectDraw);
+  commands.push_back(command);
+}
+
+void CommandList::append(const CommandList &other) {
+  GLuint recordBase = records.size();
+  GLsizei drawBase = drawCommands.size();
+  GLsizei indirectBase = indirectDraws.size();
+  indirectDraws.insert(indirectDraws.end(), other.indirectDraws.begin(),
+                       other.indirectDraws.end());
+  records.insert(records.end(), other.records.begin(), other.records.end());
+  for (DrawElementsIndirectCommand drawCommand : other.drawCommands) {
+    drawCommand.baseInstance += recordBase;
+    drawCommands.push_back(drawCommand);
+  }
+  for (RenderCommand command : other.commands) {
+    if (command.type == RenderCommand::DRAW) {
+      command.first += drawBase;
+    } else if (command.type == RenderCommand::DRAW_INDIRECT_COUNT) {
+      command.first += indirectBase;
+    }
+    commands.push_back(command);
+  }
+}
+
+void CommandList::execute() {
+  // a list of gpu written draws only has nothing to upload
+  if (!records.empty() || !drawCommands.empty()) {
+    GeometryBuffer::upload(records, drawCommands);
+  }
+  ShaderProgram *program = nullptr;
+  for (const RenderCommand &command : commands) {
+    switch (command.type) {
+    case RenderCommand::USE_PROGRAM:
+      program = command.program;
+      program->use();
+      break;
+    case RenderCommand::BIND_GEOMETRY:
+      GeometryBuffer::bind();
+      break;
+    case RenderCommand::BIND_TEXTURE:
+      GLState::bindTexture(command.slot, command.target, command.name);
+      break;
+    case RenderCommand::BIND_MATERIAL_TEXTURE:
+      // binds a 1x1 fallback while the texture is still streaming in
+      command.texture->bind(GL_TEXTURE0 + command.slot);
+      break;
+    case RenderCommand::SET_MATERIAL:
+      program->uniformSetInt(UniformID(command.slot),
+                             MaterialTable::use(command.value));
+      break;
+    case RenderCommand::SET_INT:
+      program->uniformSetInt(UniformID(command.slot), command.value);
+      break;
+    case RenderCommand::DRAW:
+      GeometryBuffer::draw(command.first, command.count);
+      break;
+    case RenderCommand::BIND_RECORDS:
+      GeometryBuffer::setRecordBuffer(command.name);
+      break;
+    case RenderCommand::DRAW_INDIRECT_COUNT: {
+      const IndirectCountDraw &draw = indirectDraws[command.first];
+      GeometryBuffer::drawIndirectCount(draw.commandBuffer,
+                                        draw.commandOffset, draw.countBuffer,
+                                        draw.countOffset, draw.maxCount);
+      break;
+    }
+    }
+  }
+}
+
+size_t CommandList::size() const { return commands.size(); }
@@ -0,0 +1,100 @@
+
+#ifndef OPENGL_COMMANDLIST_H
+#define OPENGL_COMMANDLIST_H
+
+#include "geometrybuffer.h"
+#include "shader.h"
+#include <glad/glad.h>
+#include <vector>
+
+class Texture;
+
+// one recorded operation, see CommandList
+struct RenderCommand {
+  enum Type {
+    USE_PROGRAM,
+    BIND_GEOMETRY,
+    BIND_TEXTURE,
+    BIND_MATERIAL_TEXTURE,
+    SET_MATERIAL,
+    SET_INT,
+    DRAW,
+    BIND_RECORDS,
+    DRAW_INDIRECT_COUNT
+  };
+
+  Type type;
+  // texture unit or uniform id
+  GLint slot;
+  GLenum target;
+  union {
+    ShaderProgram *program;
+    Texture *texture;
+    GLuint name;
+    GLint value; // SET_INT, the table index for SET_MATERIAL
+    GLsizei first; // DRAW, or the IndirectCountDraw of DRAW_INDIRECT_COUNT
+  };
+  GLsizei count;
+};
+
+// arguments of GeometryBuffer::drawIndirectCount, too many for a
+// RenderCommand
+struct IndirectCountDraw {
+  GLuint commandBuffer;
+  GLintptr commandOffset;
+  GLuint countBuffer;
+  GLintptr countOffset;
+  GLsizei maxCount;
+};
+
+/**
+ * the state changes and draws of a pass as plain data, recorded without a
+ * GL context so that worker threads can each fill one list from a range of
+ * packets. a list also owns the DrawRecords and draw commands its draws
+ * index. append() the lists of one pass into the first in order, then
+ * execute() uploads everything at once and replays it through GLState and
+ * GeometryBuffer on the GL thread. bindings are resolved at replay: a
+ * texture still streaming in gets its fallback then.
+ */
+class CommandList {
+public:
+  // keeps the memory for the next recording
+  void clear();
+
+  // uniform commands apply to the last program used
+  void useProgram(ShaderProgram *program);
+  // the GeometryBuffer VAO
+  void bindGeometry();
+  void bindTexture(int unit, GLenum target, GLuint texture);
+  void bindTexture(int unit, Texture *texture);
+  // binds the MaterialTable page of tableIndex and sets uniform id to the
+  // entry's slot in it
+  void setMaterial(UniformID id, unsigned int tableIndex);
+  void setInt(UniformID id, int value);
+  // index of the record, for the baseInstance of the next draw
+  GLuint addRecord(const DrawRecord &record);
+  // joins the previous draw when nothing was recorded in between, so a run
+  // of draws is one multi-draw
+  void draw(const DrawElementsIndirectCommand &drawCommand);
+  // records read from buffer instead of this list's own, 0 switches back,
+  // see GeometryBuffer::setRecordBuffer
+  void bindRecords(GLuint buffer);
+  // draws whose commands and count the gpu wrote, e.g. GpuCuller's
+  void drawIndirectCount(const IndirectCountDraw &indirectDraw);
+
+  // moves other's commands behind these, its records and draws rebased
+  void append(const CommandList &other);
+  // GL thread only
+  void execute();
+
+  // recorded commands, a run of merged draws counts once
+  size_t size() const;
+
+private:
+  std::vector<RenderCommand> commands;
+  std::vector<DrawRecord> records;
+  std::vector<DrawElementsIndirectCommand> drawCommands;
+  std::vector<IndirectCountDraw> indirectDraws;
+};
+
+#endif // OPENGL_COMMANDLIST_H
@@ -34,7 +34,10 @@ void DisplayManager::init() {
   // smaller subset of OpenGL features without backwards-compatible features we
   // no longer need
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifndef NDEBUG
+  // KHR_debug reports everything only on debug contexts, see GLDebug
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
   glfwWindowHint(GLFW_SAMPLES, 4);
 
 #ifdef __APPLE__
@@ -1,5 +1,7 @@
 
 #include "gbuffer.h"
+#include "gldebug.h"
+#include "glstate.h"
 #include "shader.h"
 #include <iostream>
 
@@ -10,11 +12,11 @@ GBuffer::GBuffer() {
 
 void GBuffer::cleanUp() {
   if (FBO != 0) {
-    glDeleteFramebuffers(1, &FBO);
+    GLState::deleteFramebuffers(1, &FBO);
   }
   if (gTextures.size() > 0) {
     for (GBufferTexture texture : gTextures) {
-      glDeleteTextures(1, &texture.textureID);
+      GLState::deleteTextures(1, &texture.textureID);
     }
   }
   if (depthRBO != 0) {
@@ -26,14 +28,15 @@ bool GBuffer::init(int scrWidth, int scrHeight,
                    std::vector<GBufferTexture> &textures, bool needDepthRBO) {
   // creat fbo
   glad_glGenFramebuffers(1, &FBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, FBO);
+  GLDebug::label(GL_FRAMEBUFFER, FBO, "G-buffer");
 
   int size = textures.size();
   std::vector<unsigned int> attachments(size);
   for (unsigned int i = 0; i < size; ++i) {
     GBufferTexture &texture = textures[i];
     glGenTextures(1, &texture.textureID);
-    glBindTexture(GL_TEXTURE_2D, texture.textureID);
+    GLState::bindTexture(GL_TEXTURE_2D, texture.textureID);
     switch (texture.type) {
     case GBUFFER_TEXTURE_TYPE_POSITION:
     case GBUFFER_TEXTRURE_NORMAL:
@@ -71,21 +74,24 @@ bool GBuffer::init(int scrWidth, int scrHeight,
     std::cout << "gBuffer fbo not complete!" << std::endl;
     return false;
   }
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
   return true;
 }
 
-void GBuffer::bind() { glBindFramebuffer(GL_FRAMEBUFFER, FBO); }
+void GBuffer::bind() { GLState::bindFramebuffer(GL_FRAMEBUFFER, FBO); }
 
-void GBuffer::bindForRead() { glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO); }
+void GBuffer::bindForRead() {
+  GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+}
 
-void GBuffer::bindForWrite() { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO); }
+void GBuffer::bindForWrite() {
+  GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+}
 
 void GBuffer::configure(ShaderProgram &shaderProgram) {
   for (unsigned int i = 0; i < gTextures.size(); ++i) {
     GBufferTexture gBufferTexture = gTextures[i];
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, gBufferTexture.textureID);
+    GLState::bindTexture(i, GL_TEXTURE_2D, gBufferTexture.textureID);
     shaderProgram.uniformSetInt(gBufferTexture.uniformName, i);
   }
 }
\ No newline at end of file
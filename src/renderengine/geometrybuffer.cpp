@@ -0,0 +1,249 @@
+
+#include "geometrybuffer.h"
+#include "gldebug.h"
+#include "glext.h"
+#include "glstate.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+// first allocation of the vertex and index buffers, they double from there
+const GLsizeiptr MIN_CAPACITY = 1024 * 1024;
+} // namespace
+
+DrawRecord::DrawRecord(const glm::mat4 &model, const glm::mat3 &normalMatrix,
+                       const VertexBounds &bounds)
+    : model(model), positionScale(bounds.scale(), 0.0f),
+      positionOffset(bounds.min, 0.0f) {
+  for (int column = 0; column < 3; ++column) {
+    this->normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+  }
+}
+
+GLuint GeometryBuffer::VAO = 0;
+GLuint GeometryBuffer::VBO = 0;
+GLuint GeometryBuffer::EBO = 0;
+GLuint GeometryBuffer::recordBuffer = 0;
+GLuint GeometryBuffer::externalRecords = 0;
+GLuint GeometryBuffer::indirectBuffer = 0;
+GLsizeiptr GeometryBuffer::vertexCapacity = 0;
+GLsizeiptr GeometryBuffer::indexCapacity = 0;
+GLsizeiptr GeometryBuffer::recordCapacity = 0;
+GLsizeiptr GeometryBuffer::indirectCapacity = 0;
+GLsizei GeometryBuffer::vertexNum = 0;
+GLsizei GeometryBuffer::indexNum = 0;
+std::vector<DrawElementsIndirectCommand> GeometryBuffer::commands;
+
+void GeometryBuffer::add(const PackedVertex *vertices,
+                         unsigned int vertexCount, const unsigned int *indices,
+                         unsigned int indexCount, GLint &baseVertex,
+                         GLuint &firstIndex) {
+  GLuint oldVBO = VBO, oldEBO = EBO;
+  reserve(VBO, vertexCapacity, vertexNum * sizeof(PackedVertex),
+          (vertexNum + vertexCount) * sizeof(PackedVertex));
+  reserve(EBO, indexCapacity, indexNum * sizeof(GLuint),
+          (indexNum + indexCount) * sizeof(GLuint));
+  if (VAO == 0 || VBO != oldVBO || EBO != oldEBO) {
+    setUpVertexArray();
+    GLDebug::label(GL_VERTEX_ARRAY, VAO, "geometry");
+    GLDebug::label(GL_BUFFER, VBO, "geometry vertices");
+    GLDebug::label(GL_BUFFER, EBO, "geometry indices");
+    GLDebug::label(GL_BUFFER, recordBuffer, "draw records");
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, vertexNum * sizeof(PackedVertex),
+                  vertexCount * sizeof(PackedVertex), vertices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, indexNum * sizeof(GLuint),
+                  indexCount * sizeof(GLuint), indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  baseVertex = vertexNum;
+  firstIndex = indexNum;
+  vertexNum += vertexCount;
+  indexNum += indexCount;
+}
+
+void GeometryBuffer::reserve(GLuint &buffer, GLsizeiptr &capacity,
+                             GLsizeiptr used, GLsizeiptr needed) {
+  if (needed <= capacity) {
+    return;
+  }
+  GLsizeiptr grown = std::max(std::max(needed, capacity * 2), MIN_CAPACITY);
+  GLuint resized;
+  glGenBuffers(1, &resized);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+  glBufferData(GL_COPY_WRITE_BUFFER, grown, NULL, GL_STATIC_DRAW);
+  if (used > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  if (buffer != 0) {
+    glDeleteBuffers(1, &buffer);
+  }
+  buffer = resized;
+  capacity = grown;
+}
+
+void GeometryBuffer::setUpVertexArray() {
+  if (VAO == 0) {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &recordBuffer);
+  }
+  GLState::bindVertexArray(VAO);
+
+  // decoded in the vertex shaders, see vertexformat.h
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE,
+                        sizeof(PackedVertex),
+                        (void *)offsetof(PackedVertex, position));
+  glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                        (void *)offsetof(PackedVertex, normal));
+  glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                        (void *)offsetof(PackedVertex, textureCoord));
+  glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                        (void *)offsetof(PackedVertex, tangent));
+  for (GLuint i = 0; i < ATTRIBUTE_NUM; ++i) {
+    glEnableVertexAttribArray(i);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+  // mat4 model, positionScale, positionOffset, mat3 normalMatrix, one
+  // record per instance
+  if (recordCapacity == 0) {
+    recordCapacity = sizeof(DrawRecord);
+    glBindBuffer(GL_ARRAY_BUFFER, recordBuffer);
+    glBufferData(GL_ARRAY_BUFFER, recordCapacity, NULL, GL_STREAM_DRAW);
+  }
+  for (GLuint i = RECORD_ATTRIBUTE; i < RECORD_ATTRIBUTE + RECORD_ATTRIBUTE_NUM;
+       ++i) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+  pointRecords(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryBuffer::pointRecords(GLuint first) {
+  size_t base = first * sizeof(DrawRecord);
+  glBindBuffer(GL_ARRAY_BUFFER,
+               externalRecords != 0 ? externalRecords : recordBuffer);
+  for (GLuint column = 0; column < 4; ++column) {
+    glVertexAttribPointer(
+        RECORD_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(DrawRecord),
+        (void *)(base + offsetof(DrawRecord, model) +
+                 column * sizeof(glm::vec4)));
+  }
+  glVertexAttribPointer(RECORD_ATTRIBUTE + 4, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(DrawRecord),
+                        (void *)(base + offsetof(DrawRecord, positionScale)));
+  glVertexAttribPointer(RECORD_ATTRIBUTE + 5, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(DrawRecord),
+                        (void *)(base + offsetof(DrawRecord, positionOffset)));
+  for (GLuint column = 0; column < 3; ++column) {
+    glVertexAttribPointer(
+        RECORD_ATTRIBUTE + 6 + column, 3, GL_FLOAT, GL_FALSE,
+        sizeof(DrawRecord),
+        (void *)(base + offsetof(DrawRecord, normalMatrix) +
+                 column * sizeof(glm::vec4)));
+  }
+}
+
+void GeometryBuffer::upload(
+    const std::vector<DrawRecord> &records,
+    const std::vector<DrawElementsIndirectCommand> &drawCommands) {
+  commands = drawCommands;
+  if (VAO == 0) {
+    return;
+  }
+  // orphaned every pass, the driver hands out fresh storage instead of
+  // waiting for the draws still reading the old records
+  GLsizeiptr bytes = records.size() * sizeof(DrawRecord);
+  recordCapacity = std::max(recordCapacity, bytes);
+  glBindBuffer(GL_ARRAY_BUFFER, recordBuffer);
+  glBufferData(GL_ARRAY_BUFFER, recordCapacity, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, records.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  if (!GLExt::hasMultiDrawIndirect()) {
+    return;
+  }
+  if (indirectBuffer == 0) {
+    glGenBuffers(1, &indirectBuffer);
+  }
+  bytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+  indirectCapacity = std::max(indirectCapacity, bytes);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity, NULL,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, commands.data());
+}
+
+void GeometryBuffer::bind() { GLState::bindVertexArray(VAO); }
+
+void GeometryBuffer::draw(GLsizei first, GLsizei count) {
+  if (GLExt::hasMultiDrawIndirect()) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    GLExt::multiDrawElementsIndirect(
+        GL_TRIANGLES, GL_UNSIGNED_INT,
+        (void *)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+    return;
+  }
+  for (GLsizei i = first; i < first + count; ++i) {
+    const DrawElementsIndirectCommand &command = commands[i];
+    pointRecords(command.baseInstance);
+    glDrawElementsInstancedBaseVertex(
+        GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+        (void *)(command.firstIndex * sizeof(GLuint)), command.instanceCount,
+        command.baseVertex);
+  }
+}
+
+void GeometryBuffer::setRecordBuffer(GLuint buffer) {
+  if (VAO == 0 || buffer == externalRecords) {
+    return;
+  }
+  externalRecords = buffer;
+  GLState::bindVertexArray(VAO);
+  pointRecords(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryBuffer::drawIndirectCount(GLuint commandBuffer,
+                                       GLintptr commandOffset,
+                                       GLuint countBuffer, GLintptr countOffset,
+                                       GLsizei maxCount) {
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+  GLExt::multiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        (void *)commandOffset, countOffset,
+                                        maxCount, 0);
+}
+
+void GeometryBuffer::cleanUp() {
+  if (VAO != 0) {
+    GLState::deleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &recordBuffer);
+  }
+  if (VBO != 0) {
+    glDeleteBuffers(1, &VBO);
+  }
+  if (EBO != 0) {
+    glDeleteBuffers(1, &EBO);
+  }
+  if (indirectBuffer != 0) {
+    glDeleteBuffers(1, &indirectBuffer);
+  }
+  VAO = VBO = EBO = recordBuffer = externalRecords = indirectBuffer = 0;
+  vertexCapacity = indexCapacity = recordCapacity = indirectCapacity = 0;
+  vertexNum = indexNum = 0;
+  commands.clear();
+}
+
+size_t GeometryBuffer::size() {
+  return size_t(vertexNum) * sizeof(PackedVertex) +
+         size_t(indexNum) * sizeof(GLuint);
+}
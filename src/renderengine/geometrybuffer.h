@@ -0,0 +1,102 @@
+
+#ifndef OPENGL_GEOMETRYBUFFER_H
+#define OPENGL_GEOMETRYBUFFER_H
+
+#include "../scene/vertexformat.h"
+#include <glad/glad.h>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+// one draw out of the shared buffers, laid out as glMultiDrawElementsIndirect
+// reads it
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// per instance constants, read by the vertex shaders as instanced
+// attributes (divisor 1) from location RECORD_ATTRIBUTE on. a command's
+// baseInstance selects the record of its first instance
+struct DrawRecord {
+  DrawRecord() = default;
+  // bounds are the mesh's quantization bounds
+  DrawRecord(const glm::mat4 &model, const glm::mat3 &normalMatrix,
+             const VertexBounds &bounds);
+
+  glm::mat4 model;
+  glm::vec4 positionScale;   // xyz, see vertexformat.h
+  glm::vec4 positionOffset;  // xyz
+  glm::vec4 normalMatrix[3]; // xyz columns, cached by Transformation
+};
+
+/**
+ * the packed vertices and indices of every static mesh, appended into one
+ * vertex and one 32-bit index buffer behind a single VAO. a mesh is then
+ * only a base vertex and a first index, and a whole batch of meshes is one
+ * glMultiDrawElementsIndirect. contexts below 4.3 get a loop of
+ * glDrawElementsInstancedBaseVertex with the record attributes re-pointed
+ * per draw instead.
+ * ranges of deleted meshes are not reused before cleanUp. GL thread only.
+ */
+class GeometryBuffer {
+public:
+  // first attribute location of DrawRecord, model takes 4 locations and
+  // normalMatrix 3, RECORD_ATTRIBUTE_NUM in all
+  static const GLuint RECORD_ATTRIBUTE = 4;
+  static const GLuint RECORD_ATTRIBUTE_NUM = 9;
+
+  // copies a mesh in and returns where it starts
+  static void add(const PackedVertex *vertices, unsigned int vertexCount,
+                  const unsigned int *indices, unsigned int indexCount,
+                  GLint &baseVertex, GLuint &firstIndex);
+  // the records and commands of a pass, draw() indexes into them
+  static void
+  upload(const std::vector<DrawRecord> &records,
+         const std::vector<DrawElementsIndirectCommand> &drawCommands);
+  static void bind();
+  // draws commands [first, first + count) of the last upload
+  static void draw(GLsizei first, GLsizei count);
+  // reads the records from buffer, e.g. one kept by GpuCuller, instead of
+  // the uploaded ones until called again with 0
+  static void setRecordBuffer(GLuint buffer);
+  // up to maxCount commands from commandOffset in commandBuffer, as many as
+  // the GLuint at countOffset in countBuffer says. needs
+  // GLExt::hasGpuCulling
+  static void drawIndirectCount(GLuint commandBuffer, GLintptr commandOffset,
+                                GLuint countBuffer, GLintptr countOffset,
+                                GLsizei maxCount);
+  static void cleanUp();
+  // vertex + index bytes in use
+  static size_t size();
+
+private:
+  // grows buffer to hold needed bytes, keeping the first used ones
+  static void reserve(GLuint &buffer, GLsizeiptr &capacity, GLsizeiptr used,
+                      GLsizeiptr needed);
+  static void setUpVertexArray();
+  // points the record attributes at record first
+  static void pointRecords(GLuint first);
+
+  static GLuint VAO;
+  static GLuint VBO;
+  static GLuint EBO;
+  static GLuint recordBuffer;
+  // set by setRecordBuffer, 0 for recordBuffer
+  static GLuint externalRecords;
+  static GLuint indirectBuffer;
+  static GLsizeiptr vertexCapacity;
+  static GLsizeiptr indexCapacity;
+  static GLsizeiptr recordCapacity;
+  static GLsizeiptr indirectCapacity;
+  static GLsizei vertexNum;
+  static GLsizei indexNum;
+  // cpu copy of the uploaded commands for the fallback path
+  static std::vector<DrawElementsIndirectCommand> commands;
+};
+
+#endif // OPENGL_GEOMETRYBUFFER_H
@@ -0,0 +1,144 @@
+#include "gldebug.h"
+
+#ifndef NDEBUG
+#include "glext.h"
+#include <iostream>
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_DEBUG_SOURCE_API
+#define GL_DEBUG_SOURCE_API 0x8246
+#endif
+#ifndef GL_DEBUG_SOURCE_WINDOW_SYSTEM
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#endif
+#ifndef GL_DEBUG_SOURCE_SHADER_COMPILER
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#endif
+#ifndef GL_DEBUG_SOURCE_THIRD_PARTY
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#endif
+#ifndef GL_DEBUG_SOURCE_APPLICATION
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#endif
+#ifndef GL_DEBUG_TYPE_ERROR
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#endif
+#ifndef GL_DEBUG_SEVERITY_HIGH
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#endif
+#ifndef GL_DEBUG_SEVERITY_MEDIUM
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#endif
+#ifndef GL_DEBUG_SEVERITY_LOW
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#endif
+#ifndef GL_DEBUG_SEVERITY_NOTIFICATION
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#endif
+
+typedef void(APIENTRYP PFNGLDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback,
+                                                      const void *userParam);
+typedef void(APIENTRYP PFNGLDEBUGMESSAGECONTROLPROC)(
+    GLenum source, GLenum type, GLenum severity, GLsizei count,
+    const GLuint *ids, GLboolean enabled);
+typedef void(APIENTRYP PFNGLOBJECTLABELPROC)(GLenum identifier, GLuint name,
+                                             GLsizei length,
+                                             const GLchar *label);
+typedef void(APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id,
+                                                GLsizei length,
+                                                const GLchar *message);
+typedef void(APIENTRYP PFNGLPOPDEBUGGROUPPROC)();
+
+namespace {
+PFNGLDEBUGMESSAGECALLBACKPROC debugMessageCallback = nullptr;
+PFNGLDEBUGMESSAGECONTROLPROC debugMessageControl = nullptr;
+PFNGLOBJECTLABELPROC objectLabel = nullptr;
+PFNGLPUSHDEBUGGROUPPROC pushDebugGroup = nullptr;
+PFNGLPOPDEBUGGROUPPROC popDebugGroup = nullptr;
+
+const char *sourceName(GLenum source) {
+  switch (source) {
+  case GL_DEBUG_SOURCE_API:
+    return "api";
+  case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+    return "window system";
+  case GL_DEBUG_SOURCE_SHADER_COMPILER:
+    return "shader compiler";
+  case GL_DEBUG_SOURCE_THIRD_PARTY:
+    return "third party";
+  case GL_DEBUG_SOURCE_APPLICATION:
+    return "application";
+  default:
+    return "other";
+  }
+}
+
+const char *severityName(GLenum severity) {
+  switch (severity) {
+  case GL_DEBUG_SEVERITY_HIGH:
+    return "high";
+  case GL_DEBUG_SEVERITY_MEDIUM:
+    return "medium";
+  case GL_DEBUG_SEVERITY_LOW:
+    return "low";
+  default:
+    return "notification";
+  }
+}
+
+void APIENTRY onMessage(GLenum source, GLenum type, GLuint id,
+                        GLenum severity, GLsizei /*length*/,
+                        const GLchar *message, const void * /*userParam*/) {
+  std::cout << "gl " << sourceName(source) << " "
+            << (type == GL_DEBUG_TYPE_ERROR ? "error" : "message") << " "
+            << id << " (" << severityName(severity) << "): " << message
+            << std::endl;
+}
+} // namespace
+
+void GLDebug::enable(GLADloadproc loader) {
+  // desktop drivers export KHR_debug under the core names
+  if (!GLExt::isVersion(4, 3) && !GLExt::hasExtension("GL_KHR_debug")) {
+    std::cout << "gl debug output: no" << std::endl;
+    return;
+  }
+  debugMessageCallback =
+      (PFNGLDEBUGMESSAGECALLBACKPROC)loader("glDebugMessageCallback");
+  debugMessageControl =
+      (PFNGLDEBUGMESSAGECONTROLPROC)loader("glDebugMessageControl");
+  objectLabel = (PFNGLOBJECTLABELPROC)loader("glObjectLabel");
+  pushDebugGroup = (PFNGLPUSHDEBUGGROUPPROC)loader("glPushDebugGroup");
+  popDebugGroup = (PFNGLPOPDEBUGGROUPPROC)loader("glPopDebugGroup");
+  if (!debugMessageCallback) {
+    return;
+  }
+  glEnable(GL_DEBUG_OUTPUT);
+  debugMessageCallback(onMessage, nullptr);
+  // notifications include every buffer placement hint, keep the rest
+  if (debugMessageControl) {
+    debugMessageControl(GL_DONT_CARE, GL_DONT_CARE,
+                        GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+  }
+  std::cout << "gl debug output: yes" << std::endl;
+}
+
+void GLDebug::label(GLenum identifier, GLuint name, const char *label) {
+  if (objectLabel && name != 0) {
+    objectLabel(identifier, name, -1, label);
+  }
+}
+
+void GLDebug::pushGroup(const char *name) {
+  if (pushDebugGroup) {
+    pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+  }
+}
+
+void GLDebug::popGroup() {
+  if (popDebugGroup) {
+    popDebugGroup();
+  }
+}
+#endif // NDEBUG
@@ -0,0 +1,54 @@
+
+#ifndef OPENGL_GLDEBUG_H
+#define OPENGL_GLDEBUG_H
+
+#include <glad/glad.h>
+
+// object identifiers of glObjectLabel missing from the 3.3 glad header
+#ifndef GL_BUFFER
+#define GL_BUFFER 0x82E0
+#endif
+#ifndef GL_PROGRAM
+#define GL_PROGRAM 0x82E2
+#endif
+#ifndef GL_VERTEX_ARRAY
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+
+/**
+ * KHR_debug validation for debug builds: the driver reports errors and
+ * warnings through a message callback, objects carry readable labels and
+ * every pass is a debug group, so messages and frame captures name what
+ * they refer to. nothing polls glGetError.
+ * defining NDEBUG (release builds) compiles all of it out, the calls below
+ * are then empty inline functions. contexts without KHR_debug (core 4.3)
+ * ignore them too. GL thread only.
+ */
+class GLDebug {
+public:
+  // installs the message callback, once after glad
+  static void enable(GLADloadproc loader);
+  // identifier is the object's namespace, e.g. GL_BUFFER, GL_PROGRAM or
+  // GL_FRAMEBUFFER. the object must have been bound once
+  static void label(GLenum identifier, GLuint name, const char *label);
+  static void pushGroup(const char *name);
+  static void popGroup();
+};
+
+// a debug group for the lifetime of the scope
+class GLDebugGroup {
+public:
+  explicit GLDebugGroup(const char *name) { GLDebug::pushGroup(name); }
+  ~GLDebugGroup() { GLDebug::popGroup(); }
+  GLDebugGroup(const GLDebugGroup &) = delete;
+  GLDebugGroup &operator=(const GLDebugGroup &) = delete;
+};
+
+#ifdef NDEBUG
+inline void GLDebug::enable(GLADloadproc) {}
+inline void GLDebug::label(GLenum, GLuint, const char *) {}
+inline void GLDebug::pushGroup(const char *) {}
+inline void GLDebug::popGroup() {}
+#endif
+
+#endif // OPENGL_GLDEBUG_H
@@ -0,0 +1,77 @@
+
+#include "glext.h"
+#include <cstring>
+#include <iostream>
+
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC GLExt::multiDrawElementsIndirect = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC GLExt::multiDrawElementsIndirectCount =
+    nullptr;
+PFNGLDISPATCHCOMPUTEPROC GLExt::dispatchCompute = nullptr;
+PFNGLMEMORYBARRIERPROC GLExt::memoryBarrier = nullptr;
+PFNGLBUFFERSTORAGEPROC GLExt::bufferStorage = nullptr;
+int GLExt::majorVersion = 3;
+int GLExt::minorVersion = 3;
+
+void GLExt::load(GLADloadproc loader) {
+  glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+  glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+  // the extension also covers baseInstance on 4.2 drivers
+  if (isVersion(4, 3) || hasExtension("GL_ARB_multi_draw_indirect")) {
+    multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader(
+        "glMultiDrawElementsIndirect");
+  }
+  if (isVersion(4, 3)) {
+    dispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)loader("glDispatchCompute");
+    memoryBarrier = (PFNGLMEMORYBARRIERPROC)loader("glMemoryBarrier");
+  }
+  if (isVersion(4, 4) || hasExtension("GL_ARB_buffer_storage")) {
+    bufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+  }
+  if (isVersion(4, 6)) {
+    multiDrawElementsIndirectCount =
+        (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader(
+            "glMultiDrawElementsIndirectCount");
+  } else if (hasExtension("GL_ARB_indirect_parameters")) {
+    multiDrawElementsIndirectCount =
+        (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader(
+            "glMultiDrawElementsIndirectCountARB");
+  }
+  // e.g. "llvmpipe (LLVM 15.0.7, 256 bits)" under Mesa's software driver
+  const GLubyte *renderer = glGetString(GL_RENDERER);
+  std::cout << "GL " << majorVersion << "." << minorVersion << " on "
+            << (renderer ? reinterpret_cast<const char *>(renderer) : "?")
+            << ", multi-draw indirect: "
+            << (hasMultiDrawIndirect() ? "yes" : "no")
+            << ", gpu culling: " << (hasGpuCulling() ? "yes" : "no")
+            << ", persistent mapping: " << (hasBufferStorage() ? "yes" : "no")
+            << std::endl;
+}
+
+bool GLExt::isVersion(int major, int minor) {
+  return majorVersion > major ||
+         (majorVersion == major && minorVersion >= minor);
+}
+
+bool GLExt::hasMultiDrawIndirect() {
+  return multiDrawElementsIndirect != nullptr && isVersion(4, 2);
+}
+
+bool GLExt::hasGpuCulling() {
+  return hasMultiDrawIndirect() && dispatchCompute != nullptr &&
+         memoryBarrier != nullptr && multiDrawElementsIndirectCount != nullptr;
+}
+
+bool GLExt::hasBufferStorage() { return bufferStorage != nullptr; }
+
+bool GLExt::hasExtension(const char *name) {
+  GLint extensionNum = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &extensionNum);
+  for (GLint i = 0; i < extensionNum; ++i) {
+    const char *extension =
+        reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,75 @@
+
+#ifndef OPENGL_GLEXT_H
+#define OPENGL_GLEXT_H
+
+#include <glad/glad.h>
+
+// glad was generated for the 3.3 core profile, newer entry points and enums
+// are resolved here at runtime and stay null when the context lacks them
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void(APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(
+    GLenum mode, GLenum type, const void *indirect, GLsizei drawcount,
+    GLsizei stride);
+typedef void(APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)(
+    GLenum mode, GLenum type, const void *indirect, GLintptr drawcount,
+    GLsizei maxdrawcount, GLsizei stride);
+typedef void(APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x,
+                                                 GLuint num_groups_y,
+                                                 GLuint num_groups_z);
+typedef void(APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target,
+                                               GLsizeiptr size,
+                                               const void *data,
+                                               GLbitfield flags);
+
+/**
+ * context version and the optional entry points the renderer uses, each
+ * with a 3.3 fallback at its call site. load once after glad.
+ */
+class GLExt {
+public:
+  static void load(GLADloadproc loader);
+  static bool isVersion(int major, int minor);
+  // glMultiDrawElementsIndirect with baseInstance, core since 4.3
+  static bool hasMultiDrawIndirect();
+  // compute shaders and shader storage buffers, core since 4.3, plus
+  // glMultiDrawElementsIndirectCount, core since 4.6
+  static bool hasGpuCulling();
+  // immutable storage that stays mapped while in use, core since 4.4
+  static bool hasBufferStorage();
+  // GL_EXTENSIONS lookup, for the few extensions checked outside load
+  static bool hasExtension(const char *name);
+
+  static PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect;
+  static PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC multiDrawElementsIndirectCount;
+  static PFNGLDISPATCHCOMPUTEPROC dispatchCompute;
+  static PFNGLMEMORYBARRIERPROC memoryBarrier;
+  static PFNGLBUFFERSTORAGEPROC bufferStorage;
+
+private:
+  static int majorVersion;
+  static int minorVersion;
+};
+
+#endif // OPENGL_GLEXT_H
@@ -0,0 +1,182 @@
+
+#include "glstate.h"
+
+namespace {
+// a binding that has to be issued whatever the caller asks for
+const GLuint UNKNOWN = ~0u;
+} // namespace
+
+// the defaults of a fresh context
+GLuint GLState::program = 0;
+GLuint GLState::vertexArray = 0;
+int GLState::activeUnit = 0;
+GLuint GLState::textures[GLState::TEXTURE_UNIT_NUM][GLState::SLOT_NUM] = {};
+GLuint GLState::drawFramebuffer = 0;
+GLuint GLState::readFramebuffer = 0;
+std::map<GLenum, bool> GLState::capabilities;
+
+unsigned int GLState::elided = 0;
+unsigned int GLState::issued = 0;
+unsigned int GLState::frameElided = 0;
+unsigned int GLState::frameIssued = 0;
+
+bool GLState::cached(GLuint &value, GLuint wanted) {
+  if (value == wanted) {
+    ++elided;
+    return true;
+  }
+  ++issued;
+  value = wanted;
+  return false;
+}
+
+void GLState::useProgram(GLuint program) {
+  if (!cached(GLState::program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+  if (!cached(GLState::vertexArray, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+int GLState::textureSlot(GLenum target) {
+  switch (target) {
+  case GL_TEXTURE_2D:
+    return SLOT_2D;
+  case GL_TEXTURE_CUBE_MAP:
+    return SLOT_CUBE_MAP;
+  case GL_TEXTURE_BUFFER:
+    return SLOT_BUFFER;
+  }
+  return -1;
+}
+
+void GLState::activeTexture(int unit) {
+  if (activeUnit == unit) {
+    return;
+  }
+  ++issued;
+  activeUnit = unit;
+  glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture) {
+  int slot = textureSlot(target);
+  if (unit >= TEXTURE_UNIT_NUM || slot < 0) {
+    activeTexture(unit);
+    ++issued;
+    glBindTexture(target, texture);
+    return;
+  }
+  if (!cached(textures[unit][slot], texture)) {
+    activeTexture(unit);
+    glBindTexture(target, texture);
+  }
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture) {
+  bindTexture(activeUnit < 0 ? 0 : activeUnit, target, texture);
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer) {
+  if (target == GL_DRAW_FRAMEBUFFER) {
+    if (!cached(drawFramebuffer, framebuffer)) {
+      glBindFramebuffer(target, framebuffer);
+    }
+    return;
+  }
+  if (target == GL_READ_FRAMEBUFFER) {
+    if (!cached(readFramebuffer, framebuffer)) {
+      glBindFramebuffer(target, framebuffer);
+    }
+    return;
+  }
+  if (drawFramebuffer == framebuffer && readFramebuffer == framebuffer) {
+    ++elided;
+    return;
+  }
+  ++issued;
+  drawFramebuffer = readFramebuffer = framebuffer;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::enable(GLenum capability) {
+  std::map<GLenum, bool>::iterator it = capabilities.find(capability);
+  if (it != capabilities.end() && it->second) {
+    ++elided;
+    return;
+  }
+  ++issued;
+  capabilities[capability] = true;
+  glEnable(capability);
+}
+
+void GLState::disable(GLenum capability) {
+  std::map<GLenum, bool>::iterator it = capabilities.find(capability);
+  if (it != capabilities.end() && !it->second) {
+    ++elided;
+    return;
+  }
+  ++issued;
+  capabilities[capability] = false;
+  glDisable(capability);
+}
+
+void GLState::deleteTextures(GLsizei n, const GLuint *textures) {
+  for (GLsizei i = 0; i < n; ++i) {
+    for (int unit = 0; unit < TEXTURE_UNIT_NUM; ++unit) {
+      for (int slot = 0; slot < SLOT_NUM; ++slot) {
+        if (GLState::textures[unit][slot] == textures[i]) {
+          GLState::textures[unit][slot] = 0;
+        }
+      }
+    }
+  }
+  glDeleteTextures(n, textures);
+}
+
+void GLState::deleteVertexArrays(GLsizei n, const GLuint *vertexArrays) {
+  for (GLsizei i = 0; i < n; ++i) {
+    if (vertexArray == vertexArrays[i]) {
+      vertexArray = 0;
+    }
+  }
+  glDeleteVertexArrays(n, vertexArrays);
+}
+
+void GLState::deleteFramebuffers(GLsizei n, const GLuint *framebuffers) {
+  for (GLsizei i = 0; i < n; ++i) {
+    if (drawFramebuffer == framebuffers[i]) {
+      drawFramebuffer = 0;
+    }
+    if (readFramebuffer == framebuffers[i]) {
+      readFramebuffer = 0;
+    }
+  }
+  glDeleteFramebuffers(n, framebuffers);
+}
+
+void GLState::invalidate() {
+  program = vertexArray = UNKNOWN;
+  activeUnit = -1;
+  for (int unit = 0; unit < TEXTURE_UNIT_NUM; ++unit) {
+    for (int slot = 0; slot < SLOT_NUM; ++slot) {
+      textures[unit][slot] = UNKNOWN;
+    }
+  }
+  drawFramebuffer = readFramebuffer = UNKNOWN;
+  capabilities.clear();
+}
+
+void GLState::endFrame() {
+  frameElided = elided;
+  frameIssued = issued;
+  elided = issued = 0;
+}
+
+unsigned int GLState::elidedCalls() { return frameElided; }
+
+unsigned int GLState::issuedCalls() { return frameIssued; }
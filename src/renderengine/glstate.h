@@ -0,0 +1,69 @@
+
+#ifndef OPENGL_GLSTATE_H
+#define OPENGL_GLSTATE_H
+
+#include <glad/glad.h>
+#include <map>
+
+/**
+ * shadow copy of the GL bindings the renderer changes per draw: program,
+ * vertex array, texture per unit and target, draw/read framebuffer and
+ * enable bits. a call that would not change the current binding is dropped
+ * and counted, so draws can bind everything they need without unbinding
+ * afterwards.
+ * everything that changes these bindings has to go through here, call
+ * invalidate() after code that does not. GL thread only.
+ */
+class GLState {
+public:
+  // units above this are bound without caching
+  static const int TEXTURE_UNIT_NUM = 16;
+
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vertexArray);
+  // selects the unit only when the binding changes
+  static void bindTexture(int unit, GLenum target, GLuint texture);
+  // binds on the active unit, for creating and updating textures
+  static void bindTexture(GLenum target, GLuint texture);
+  // GL_FRAMEBUFFER sets both the draw and the read binding
+  static void bindFramebuffer(GLenum target, GLuint framebuffer);
+  static void enable(GLenum capability);
+  static void disable(GLenum capability);
+
+  // deleting unbinds the objects, and the names may be handed out again
+  static void deleteTextures(GLsizei n, const GLuint *textures);
+  static void deleteVertexArrays(GLsizei n, const GLuint *vertexArrays);
+  static void deleteFramebuffers(GLsizei n, const GLuint *framebuffers);
+
+  // forgets everything, the next call of each kind is issued
+  static void invalidate();
+  // closes the frame counters, read them with elidedCalls/issuedCalls
+  static void endFrame();
+  // calls dropped / passed on during the last finished frame
+  static unsigned int elidedCalls();
+  static unsigned int issuedCalls();
+
+private:
+  // cached texture targets, others are bound without caching
+  enum TextureSlot { SLOT_2D, SLOT_CUBE_MAP, SLOT_BUFFER, SLOT_NUM };
+
+  static int textureSlot(GLenum target);
+  static void activeTexture(int unit);
+  // true when value already holds the wanted binding, else stores it
+  static bool cached(GLuint &value, GLuint wanted);
+
+  static GLuint program;
+  static GLuint vertexArray;
+  static int activeUnit;
+  static GLuint textures[TEXTURE_UNIT_NUM][SLOT_NUM];
+  static GLuint drawFramebuffer;
+  static GLuint readFramebuffer;
+  static std::map<GLenum, bool> capabilities;
+
+  static unsigned int elided;
+  static unsigned int issued;
+  static unsigned int frameElided;
+  static unsigned int frameIssued;
+};
+
+#endif // OPENGL_GLSTATE_H
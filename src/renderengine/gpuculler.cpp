@@ -0,0 +1,255 @@
+#include "gpuculler.h"
+#include "../material/material.h"
+#include "../scene/scene.h"
+#include "geometrybuffer.h"
+#include "gldebug.h"
+#include "glext.h"
+#include <map>
+#include <utility>
+
+namespace {
+// local_size_x of cullCompute.shader
+const GLuint LOCAL_SIZE = 64;
+
+const UniformID PLANES[Frustum::PLANE_NUM] = {
+    ShaderProgram::uniformID("planes[0]"),
+    ShaderProgram::uniformID("planes[1]"),
+    ShaderProgram::uniformID("planes[2]"),
+    ShaderProgram::uniformID("planes[3]"),
+    ShaderProgram::uniformID("planes[4]"),
+    ShaderProgram::uniformID("planes[5]")};
+const UniformID RECORD_NUM = ShaderProgram::uniformID("recordNum");
+const UniformID PER_BATCH = ShaderProgram::uniformID("perBatch");
+
+// std430 layout of CullRecord in cullCompute.shader, 32 bytes
+struct CullRecord {
+  glm::vec4 sphere; // world space center, radius
+  GLuint count;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint batch;
+};
+
+// (tableIndex, textureSetIndex), meshes without a material get the largest
+typedef std::pair<unsigned int, unsigned int> BatchKey;
+
+void uploadStorage(GLuint &buffer, GLsizeiptr bytes, const void *data,
+                   GLenum usage, const char *label) {
+  if (buffer == 0) {
+    glGenBuffers(1, &buffer);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, usage);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  GLDebug::label(GL_BUFFER, buffer, label);
+}
+} // namespace
+
+void GpuCuller::setProgram(ShaderProgram *program) {
+  this->program = program;
+}
+
+bool GpuCuller::isEnabled() const {
+  return program != nullptr && GLExt::hasGpuCulling();
+}
+
+void GpuCuller::upload(Scene &scene) {
+  const SceneBVH &bvh = scene.bvh;
+  recordNum = bvh.size();
+  std::vector<CullRecord> cullRecords(recordNum);
+  std::vector<DrawRecord> drawRecords(recordNum);
+  std::vector<GLuint> batchSizes;
+  std::map<BatchKey, GLuint> batchOf;
+  batchMaterials.clear();
+  for (GLsizei id = 0; id < recordNum; ++id) {
+    const BVHItem &item = bvh.item(id);
+    Mesh &mesh = scene.models[item.model].meshes[item.mesh];
+    Material *material =
+        mesh.materials.empty() ? nullptr : &mesh.materials[0];
+    BatchKey key = material ? BatchKey(material->tableIndex,
+                                       material->textureSetIndex)
+                            : BatchKey(~0u, ~0u);
+    std::map<BatchKey, GLuint>::iterator batch = batchOf.find(key);
+    if (batch == batchOf.end()) {
+      batch = batchOf.insert(std::make_pair(key, batchSizes.size())).first;
+      batchMaterials.push_back(material);
+      batchSizes.push_back(0);
+    }
+    ++batchSizes[batch->second];
+
+    const BoundingSphere &sphere = bvh.sphere(id);
+    DrawElementsIndirectCommand command = mesh.drawCommand(id, 1);
+    cullRecords[id] = CullRecord{glm::vec4(sphere.center, sphere.radius),
+                                 command.count, command.firstIndex,
+                                 command.baseVertex, batch->second};
+    drawRecords[id] = DrawRecord(bvh.transform(item.instance),
+                                 bvh.normalMatrix(item.instance), mesh.bounds);
+  }
+  batchOffsets.assign(1, 0);
+  for (GLuint size : batchSizes) {
+    batchOffsets.push_back(batchOffsets.back() + size);
+  }
+  zeroCounts.assign(batchSizes.size() + 1, 0);
+
+  uploadStorage(cullRecordBuffer, recordNum * sizeof(CullRecord),
+                cullRecords.data(), GL_STATIC_DRAW, "cull records");
+  uploadStorage(batchOffsetBuffer, batchOffsets.size() * sizeof(GLuint),
+                batchOffsets.data(), GL_STATIC_DRAW, "cull batch offsets");
+  // written and read by the gpu only
+  uploadStorage(commandBuffer,
+                recordNum * sizeof(DrawElementsIndirectCommand), NULL,
+                GL_DYNAMIC_COPY, "culled draw commands");
+  uploadStorage(countBuffer, zeroCounts.size() * sizeof(GLuint), NULL,
+                GL_DYNAMIC_COPY, "culled draw counts");
+  if (drawRecordBuffer == 0) {
+    glGenBuffers(1, &drawRecordBuffer);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, drawRecordBuffer);
+  glBufferData(GL_ARRAY_BUFFER, recordNum * sizeof(DrawRecord),
+               drawRecords.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  GLDebug::label(GL_BUFFER, drawRecordBuffer, "culled draw records");
+
+  uploaded = true;
+  uploadedVersion = bvh.getVersion();
+}
+
+void GpuCuller::draw(Scene &scene, ShaderProgram &shaderProgram,
+                     const Frustum &frustum, bool withMaterials) {
+  if (!uploaded || scene.bvh.getVersion() != uploadedVersion) {
+    upload(scene);
+  }
+  countedBatches = 0;
+  if (recordNum == 0) {
+    return;
+  }
+  GLsizei batchNum = withMaterials ? GLsizei(batchMaterials.size()) : 1;
+  countedBatches = batchNum;
+  GLDebugGroup group("gpu culling");
+
+  // cull: zero the counters the visible records append to, then one
+  // thread per record
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, batchNum * sizeof(GLuint),
+                  zeroCounts.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  program->use();
+  for (int i = 0; i < Frustum::PLANE_NUM; ++i) {
+    program->uniformSetVec4F(PLANES[i], frustum.planes[i]);
+  }
+  program->uniformSetInt(RECORD_NUM, recordNum);
+  program->uniformSetBool(PER_BATCH, withMaterials);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cullRecordBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batchOffsetBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, countBuffer);
+  GLExt::dispatchCompute((recordNum + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1);
+  // the draws read the commands and counts as indirect parameters
+  GLExt::memoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+  // draw: without materials everything went into batch 0
+  commandList.clear();
+  commandList.useProgram(&shaderProgram);
+  commandList.bindGeometry();
+  commandList.bindRecords(drawRecordBuffer);
+  for (GLsizei b = 0; b < batchNum; ++b) {
+    GLsizei maxCount = withMaterials
+                           ? GLsizei(batchOffsets[b + 1] - batchOffsets[b])
+                           : recordNum;
+    if (withMaterials && batchMaterials[b]) {
+      batchMaterials[b]->record(commandList);
+    }
+    commandList.drawIndirectCount(IndirectCountDraw{
+        commandBuffer, GLintptr(batchOffsets[b] *
+                                sizeof(DrawElementsIndirectCommand)),
+        countBuffer, GLintptr(b * sizeof(GLuint)), maxCount});
+  }
+  commandList.bindRecords(0);
+  commandList.execute();
+}
+
+void GpuCuller::queueReadBack(unsigned int tag) {
+  if (countedBatches == 0) {
+    return;
+  }
+  ReadBack *readBack = nullptr;
+  for (ReadBack &candidate : readBacks) {
+    if (!candidate.fence) {
+      readBack = &candidate;
+      break;
+    }
+  }
+  if (!readBack) {
+    readBacks.push_back(ReadBack{0, 0, nullptr, 0, 0, 0});
+    readBack = &readBacks.back();
+  }
+  GLsizeiptr bytes = countedBatches * sizeof(GLuint);
+  if (readBack->buffer == 0) {
+    glGenBuffers(1, &readBack->buffer);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, readBack->buffer);
+  if (bytes > readBack->capacity) {
+    readBack->capacity = bytes;
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  readBack->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readBack->tag = tag;
+  readBack->batchNum = countedBatches;
+  readBack->recordNum = recordNum;
+}
+
+void GpuCuller::collect(std::vector<CullCount> &counts) {
+  std::vector<GLuint> drawCounts;
+  for (ReadBack &readBack : readBacks) {
+    if (!readBack.fence) {
+      continue;
+    }
+    GLenum status =
+        glClientWaitSync(readBack.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      continue;
+    }
+    glDeleteSync(readBack.fence);
+    readBack.fence = nullptr;
+    drawCounts.resize(readBack.batchNum);
+    glBindBuffer(GL_COPY_READ_BUFFER, readBack.buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                       drawCounts.size() * sizeof(GLuint), drawCounts.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    GLuint drawn = 0;
+    for (GLuint count : drawCounts) {
+      drawn += count;
+    }
+    counts.push_back(
+        CullCount{readBack.tag, readBack.recordNum - drawn, drawn});
+  }
+}
+
+void GpuCuller::cleanUp() {
+  GLuint buffers[] = {cullRecordBuffer, batchOffsetBuffer, commandBuffer,
+                      countBuffer, drawRecordBuffer};
+  for (GLuint buffer : buffers) {
+    if (buffer != 0) {
+      glDeleteBuffers(1, &buffer);
+    }
+  }
+  cullRecordBuffer = batchOffsetBuffer = commandBuffer = countBuffer =
+      drawRecordBuffer = 0;
+  for (ReadBack &readBack : readBacks) {
+    if (readBack.fence) {
+      glDeleteSync(readBack.fence);
+    }
+    glDeleteBuffers(1, &readBack.buffer);
+  }
+  readBacks.clear();
+  uploaded = false;
+  recordNum = 0;
+  countedBatches = 0;
+  batchOffsets.clear();
+  batchMaterials.clear();
+  zeroCounts.clear();
+}
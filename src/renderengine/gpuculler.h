@@ -0,0 +1,84 @@
+
+#ifndef OPENGL_GPUCULLER_H
+#define OPENGL_GPUCULLER_H
+
+#include "../camera/frustum.h"
+#include "commandlist.h"
+#include "shader.h"
+#include <glad/glad.h>
+#include <vector>
+
+class Material;
+class Scene;
+
+// mesh instances one draw() culled and drew, see GpuCuller::collect
+struct CullCount {
+  unsigned int tag;
+  GLuint culled;
+  GLuint drawn;
+};
+
+/**
+ * frustum culling in a compute shader. every mesh instance of the scene
+ * BVH keeps a bounding sphere and its draw arguments in a storage buffer,
+ * its DrawRecord in a vertex buffer, both indexed by BVH item id and
+ * re-uploaded only when the BVH changes. a pass dispatches one thread per
+ * item, the visible ones append a DrawElementsIndirectCommand to their
+ * material batch, and each batch is then one
+ * glMultiDrawElementsIndirectCount: the cpu never walks the meshes and
+ * never waits for the counts. the draws go through a CommandList like the
+ * cpu path's, the dispatch is issued directly, it is one call per pass.
+ * needs GLExt::hasGpuCulling. GL thread only.
+ */
+class GpuCuller {
+public:
+  // the cull compute shader, null turns the culler off
+  void setProgram(ShaderProgram *program);
+  bool isEnabled() const;
+  // culls every mesh instance of scene against frustum and draws the rest
+  // with shaderProgram, one material batch at a time when withMaterials
+  void draw(Scene &scene, ShaderProgram &shaderProgram,
+            const Frustum &frustum, bool withMaterials);
+  // copies the draw counts of the last draw() aside behind a fence, tag
+  // tells the passes apart in collect()
+  void queueReadBack(unsigned int tag);
+  // appends the counts of every copy the gpu has finished, usually one or
+  // two frames old, and never waits for the others
+  void collect(std::vector<CullCount> &counts);
+  void cleanUp();
+
+private:
+  // a copy of the draw counts on its way back, free once fence is null
+  struct ReadBack {
+    GLuint buffer;
+    GLsizeiptr capacity;
+    GLsync fence;
+    unsigned int tag;
+    GLsizei batchNum;
+    GLsizei recordNum;
+  };
+
+  // rewrites the per item buffers and the batches from the scene BVH
+  void upload(Scene &scene);
+
+  ShaderProgram *program = nullptr;
+  GLuint cullRecordBuffer = 0;
+  GLuint batchOffsetBuffer = 0;
+  GLuint commandBuffer = 0;
+  GLuint countBuffer = 0;
+  GLuint drawRecordBuffer = 0;
+  bool uploaded = false;
+  unsigned int uploadedVersion = 0;
+  GLsizei recordNum = 0;
+  // batch b owns command slots [batchOffsets[b], batchOffsets[b + 1])
+  std::vector<GLuint> batchOffsets;
+  std::vector<Material *> batchMaterials;
+  // cleared into the counts before every dispatch
+  std::vector<GLuint> zeroCounts;
+  GLsizei countedBatches = 0;
+  std::vector<ReadBack> readBacks;
+  // the batches of the last draw(), recorded and replayed
+  CommandList commandList;
+};
+
+#endif // OPENGL_GPUCULLER_H
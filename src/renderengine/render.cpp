@@ -2,47 +2,86 @@
 #include "render.h"
 #include "../light/directionallight.h"
 #include "../scene/scene.h"
+#include "gldebug.h"
+#include "glstate.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
-#include <iostream>
 #include <set>
 
+namespace {
+const UniformID VIEW_POS = ShaderProgram::uniformID("viewPos");
+// bytes of per pass uniform blocks one frame starts out with
+const GLsizeiptr UNIFORM_RING_CAPACITY = 16 * 1024;
+// sorted packets recorded per job, fewer are recorded on the GL thread.
+// low enough that Sponza's few hundred visible meshes spread over the cores
+const size_t MIN_RECORD_PACKETS = 64;
+
+// distance along the view direction mapped to [0, 1] on a log scale, so
+// that nearby meshes, where the order matters most, get most of the range
+float normalizedDepth(const Camera &camera, const glm::vec3 &position) {
+  float distance =
+      glm::dot(position - camera.getPosition(), camera.getFront());
+  distance = std::max(distance, camera.getNear());
+  return std::log(distance / camera.getNear()) /
+         std::log(camera.getFar() / camera.getNear());
+}
+} // namespace
+
+RenderQueue Render::queue;
+std::vector<uint32_t> Render::visibleItems;
+OcclusionCuller Render::occlusionCuller;
+GpuCuller Render::gpuCuller;
+std::vector<CullCount> Render::cullCounts;
+bool Render::gpuCullGBuffer = true;
+unsigned int Render::gpuDrawn[3] = {0, 0, 0};
+double Render::recordTime[3] = {0.0, 0.0, 0.0};
+unsigned int Render::recordJobs[3] = {0, 0, 0};
+std::vector<uint32_t> Render::visibleInstances;
+unsigned int Render::culled[3] = {0, 0, 0};
+std::vector<CommandList> Render::commandLists;
+std::unique_ptr<ThreadPool> Render::pool;
+UniformRing Render::uniformRing(UNIFORM_RING_CAPACITY);
+
 void Render::prepare(Camera *camera, DisplayManager &displayManager) {
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-  // uniform buffer object
+  // Matrices block: projection, view
   if (camera) {
-    GLuint uboMatrices;
-    glGenBuffers(1, &uboMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL,
-                 GL_STATIC_DRAW);
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0,
-                      2 * sizeof(glm::mat4));
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                    glm::value_ptr(camera->getProjectionMatrix(true)));
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-                    glm::value_ptr(camera->getViewMatrix()));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glm::mat4 matrices[2] = {camera->getProjectionMatrix(true),
+                             camera->getViewMatrix()};
+    UniformRing::bind(MATRICES_BINDING,
+                      uniformRing.write(matrices, sizeof(matrices)));
   }
   glViewport(0, 0, 2 * displayManager.width, 2 * displayManager.height);
 }
 
 void Render::renderShadowMap(Scene &scene, ShaderProgram &shaderProgram,
                              std::set<LightType> &lightTypes) {
+  GLDebugGroup group("shadow maps");
   glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
 
   for (unsigned int i = 0; i < scene.lights.size(); ++i) {
     Light *light = scene.lights[i];
-    if (!lightTypes.count(light->lightType)) {
+    if (!light->castsShadow || !lightTypes.count(light->lightType)) {
       continue;
     }
     light->configureShadowMatrices(shaderProgram);
-    glBindFramebuffer(GL_FRAMEBUFFER, light->shadowMapFBO);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, light->shadowMapFBO);
     glClear(GL_DEPTH_BUFFER_BIT);
-    render(scene, shaderProgram);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glm::vec3 center;
+    float radius;
+    if (light->shadowSphere(center, radius)) {
+      renderSphere(scene, shaderProgram, center, radius);
+      continue;
+    }
+    Frustum frustum = light->shadowFrustum();
+    render(scene, shaderProgram, false, false, false, RenderPass::SHADOW,
+           &frustum);
   }
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Render::debugRenderShadowMap(Scene &scene, ShaderProgram &shaderProgram) {
@@ -50,55 +89,241 @@ void Render::debugRenderShadowMap(Scene &scene, ShaderProgram &shaderProgram) {
   light->configureShadowMatrices(shaderProgram);
   shaderProgram.uniformSetFloat("near", 1.0f);
   shaderProgram.uniformSetFloat("far", 7.5f);
-  render(scene, shaderProgram, false, false, true);
+  Frustum frustum = light->shadowFrustum();
+  render(scene, shaderProgram, false, false, true, RenderPass::FORWARD,
+         &frustum);
 }
 
 void Render::render(Scene &scene, ShaderProgram &shaderProgram, bool withLights,
-                    bool withMaterials, bool withShadowMap) {
+                    bool withMaterials, bool withShadowMap, RenderPass pass,
+                    const Frustum *frustum) {
   // camera
-  shaderProgram.uniformSetVec3F("viewPos", scene.camera->getPosition());
+  shaderProgram.uniformSetVec3F(VIEW_POS, scene.camera->getPosition());
 
   // lights
   if (withLights) {
-    configureLights(scene.lights, shaderProgram);
+    configureLights(scene, shaderProgram);
   }
 
-  // models
-  for (unsigned int i = 0; i < scene.models.size(); ++i) {
-    std::vector<Light *> nullLights{};
-    scene.models[i].draw(shaderProgram,
-                         withShadowMap ? scene.lights : nullLights,
-                         withMaterials);
-    std::cout << "render:" << glGetError() << std::endl;
+  // shadow maps stay bound for the whole pass
+  if (withShadowMap) {
+    for (Light *light : scene.lights) {
+      light->activeShadowTex();
+    }
+  }
+
+  // culled and batched by the gpu when it can, the G-buffer pass unless
+  // setGpuCulling kept it on the cpu for the occlusion test
+  bool onGpu = pass == RenderPass::SHADOW ||
+               (pass == RenderPass::GBUFFER && gpuCullGBuffer);
+  if (gpuCuller.isEnabled() && onGpu) {
+    gpuCuller.draw(scene, shaderProgram,
+                   frustum ? *frustum : scene.camera->getFrustum(),
+                   withMaterials);
+    gpuCuller.queueReadBack(unsigned(pass));
+    cullCounts.clear();
+    gpuCuller.collect(cullCounts);
+    for (const CullCount &count : cullCounts) {
+      culled[count.tag] += count.culled;
+      gpuDrawn[count.tag] += count.drawn;
+    }
+    return;
   }
+
+  scene.bvh.queryFrustum(frustum ? *frustum : scene.camera->getFrustum(),
+                         visibleItems);
+  drawVisible(scene, shaderProgram, withMaterials, pass);
+}
+
+void Render::renderSphere(Scene &scene, ShaderProgram &shaderProgram,
+                          const glm::vec3 &center, float radius) {
+  shaderProgram.uniformSetVec3F(VIEW_POS, scene.camera->getPosition());
+  scene.bvh.querySphere(center, radius, visibleItems);
+  drawVisible(scene, shaderProgram, false, RenderPass::SHADOW);
+}
+
+void Render::drawVisible(Scene &scene, ShaderProgram &shaderProgram,
+                         bool withMaterials, RenderPass pass) {
+  // meshes, grouped by state
+  submitMeshes(scene, shaderProgram.programID, withMaterials, pass);
+  queue.sort();
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  recordJobs[int(pass)] += recordPackets(scene, shaderProgram, withMaterials);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  recordTime[int(pass)] += elapsed.count();
+  commandLists[0].execute();
+}
+
+unsigned int Render::culledMeshes(RenderPass pass) {
+  return culled[int(pass)];
+}
+
+unsigned int Render::gpuDrawnMeshes(RenderPass pass) {
+  return gpuDrawn[int(pass)];
+}
+
+double Render::recordMilliseconds(RenderPass pass) {
+  return recordTime[int(pass)];
+}
+
+unsigned int Render::recordJobCount(RenderPass pass) {
+  return recordJobs[int(pass)];
+}
+
+const OcclusionCuller &Render::occlusion() { return occlusionCuller; }
+
+void Render::endFrame() {
+  std::fill(culled, culled + 3, 0);
+  std::fill(gpuDrawn, gpuDrawn + 3, 0);
+  std::fill(recordTime, recordTime + 3, 0.0);
+  std::fill(recordJobs, recordJobs + 3, 0);
+  occlusionCuller.resetStats();
+  uniformRing.endFrame();
 }
 
-void Render::configureLights(std::vector<Light *> &lights,
-                             ShaderProgram &shaderProgram) {
-  int dirNum = 0, pointNum = 0, spotNum = 0;
-  std::string lightIndexStr;
-  int depthMapNum = 0;
-  for (unsigned int i = 0; i < lights.size(); ++i) {
-    Light *light = lights[i];
-    light->depthMapIndex = depthMapNum++;
-    std::string lightTypeStr = LightTypeToString(light->lightType);
-    switch (light->lightType) {
-    case LightType::DIRECT:
-      lightIndexStr = std::to_string(dirNum++);
-      break;
-    case LightType::POINT:
-      lightIndexStr = std::to_string(pointNum++);
-      break;
-    case LightType::FLASH:
-    case LightType::SPOT:
-      lightIndexStr = std::to_string(spotNum++);
-      break;
+void Render::setGpuCulling(ShaderProgram *cullProgram, bool gBuffer) {
+  gpuCuller.setProgram(cullProgram);
+  gpuCullGBuffer = gBuffer;
+}
+
+void Render::cleanUp() {
+  gpuCuller.cleanUp();
+  uniformRing.cleanUp();
+}
+
+ThreadPool &Render::workers() {
+  if (!pool) {
+    pool.reset(new ThreadPool());
+  }
+  return *pool;
+}
+
+size_t Render::recordPackets(Scene &scene, ShaderProgram &shaderProgram,
+                             bool withMaterials) {
+  size_t packetNum = queue.packets().size();
+  size_t jobNum = std::min<size_t>(workers().size(),
+                                   packetNum / MIN_RECORD_PACKETS);
+  jobNum = std::max<size_t>(jobNum, 1);
+  if (commandLists.size() < jobNum) {
+    commandLists.resize(jobNum);
+  }
+
+  // ranges 1.. on the workers, range 0 here behind the pass setup
+  std::vector<std::future<void>> jobs;
+  for (size_t j = 1; j < jobNum; ++j) {
+    size_t first = packetNum * j / jobNum;
+    size_t last = packetNum * (j + 1) / jobNum;
+    CommandList *commandList = &commandLists[j];
+    jobs.push_back(workers().submit([&scene, first, last, withMaterials,
+                                     commandList]() {
+      commandList->clear();
+      recordRange(scene, first, last, withMaterials, *commandList);
+    }));
+  }
+  CommandList &commandList = commandLists[0];
+  commandList.clear();
+  commandList.useProgram(&shaderProgram);
+  commandList.bindGeometry();
+  recordRange(scene, 0, packetNum / jobNum, withMaterials, commandList);
+  for (size_t j = 1; j < jobNum; ++j) {
+    jobs[j - 1].get();
+    commandList.append(commandLists[j]);
+  }
+  return jobNum;
+}
+
+void Render::recordRange(Scene &scene, size_t first, size_t last,
+                         bool withMaterials, CommandList &commandList) {
+  const std::vector<DrawPacket> &packets = queue.packets();
+  const Material *previous = nullptr;
+  for (size_t i = first; i < last; ++i) {
+    const DrawPacket &packet = packets[i];
+    Mesh &mesh = *packet.mesh;
+    // one record per visible instance, consecutive so that a single
+    // instanced command covers all of them
+    GLuint baseInstance = 0;
+    for (uint32_t v = packet.firstInstance;
+         v < packet.firstInstance + packet.instanceCount; ++v) {
+      uint32_t instance = visibleInstances[v];
+      GLuint record = commandList.addRecord(
+          DrawRecord(scene.bvh.transform(instance),
+                     scene.bvh.normalMatrix(instance), mesh.bounds));
+      if (v == packet.firstInstance) {
+        baseInstance = record;
+      }
     }
-    light->configure(shaderProgram, lightTypeStr, lightIndexStr);
+
+    // the queue already put equal materials next to each other, each range
+    // sets its first one again
+    Material *material = withMaterials && !mesh.materials.empty()
+                             ? &mesh.materials[0]
+                             : nullptr;
+    bool sameMaterial =
+        i > first &&
+        (material == previous ||
+         (material && previous &&
+          material->tableIndex == previous->tableIndex &&
+          material->textureSetIndex == previous->textureSetIndex));
+    if (material && !sameMaterial) {
+      material->record(commandList);
+    }
+    previous = material;
+    commandList.draw(mesh.drawCommand(baseInstance, packet.instanceCount));
   }
-  shaderProgram.uniformSetInt("dirNum", dirNum);
-  shaderProgram.uniformSetInt("pointNum", pointNum);
-  shaderProgram.uniformSetInt("spotNum", spotNum);
+}
+
+void Render::submitMeshes(Scene &scene, GLuint program, bool withMaterials,
+                          RenderPass pass) {
+  queue.clear();
+  visibleInstances.clear();
+  if (pass == RenderPass::GBUFFER) {
+    glm::mat4 viewProjection = scene.camera->getProjectionMatrix(true) *
+                               scene.camera->getViewMatrix();
+    occlusionCuller.render(scene.bvh, scene.models, visibleItems,
+                           viewProjection);
+    occlusionCuller.cull(scene.bvh, visibleItems);
+  }
+  culled[int(pass)] += scene.bvh.size() - visibleItems.size();
+  // item ids run mesh by mesh, sorted they group each mesh's instances
+  std::sort(visibleItems.begin(), visibleItems.end());
+
+  bool frontToBack = pass == RenderPass::GBUFFER;
+  size_t i = 0;
+  while (i < visibleItems.size()) {
+    const BVHItem &item = scene.bvh.item(visibleItems[i]);
+    Mesh &mesh = scene.models[item.model].meshes[item.mesh];
+    // the shadow passes look from the lights, the camera depth means
+    // nothing there. instanced meshes sort by their nearest instance
+    float depth = pass == RenderPass::SHADOW ? 0.0f : 1.0f;
+    uint32_t firstVisible = visibleInstances.size();
+    for (; i < visibleItems.size(); ++i) {
+      const BVHItem &instance = scene.bvh.item(visibleItems[i]);
+      if (instance.model != item.model || instance.mesh != item.mesh) {
+        break;
+      }
+      visibleInstances.push_back(instance.instance);
+      if (pass != RenderPass::SHADOW) {
+        glm::vec3 position = scene.bvh.sphere(visibleItems[i]).center;
+        depth = std::min(depth, normalizedDepth(*scene.camera, position));
+      }
+    }
+
+    unsigned int material = 0, textureSet = 0;
+    if (withMaterials && !mesh.materials.empty()) {
+      material = mesh.materials[0].tableIndex;
+      textureSet = mesh.materials[0].textureSetIndex;
+    }
+    queue.submit(RenderQueue::makeKey(pass, program, material, textureSet,
+                                      depth, frontToBack),
+                 &mesh, firstVisible, visibleInstances.size() - firstVisible);
+  }
+}
+
+void Render::configureLights(Scene &scene, ShaderProgram &shaderProgram) {
+  scene.lightBuffer.update(scene.lights);
+  scene.lightBuffer.configure(shaderProgram);
 }
 
 void Render::renderSkyBox(Scene &scene, ShaderProgram &shaderProgram) {
@@ -110,14 +335,10 @@ void Render::renderSkyBox(Scene &scene, ShaderProgram &shaderProgram) {
   shaderProgram.uniformSetMat4("projection", projectionTransform);
 
   glDepthFunc(GL_LEQUAL);
-  glBindVertexArray(scene.skyBox->VAO);
-  glEnableVertexAttribArray(0);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, scene.skyBox->textureID);
+  GLState::bindVertexArray(scene.skyBox->VAO);
+  GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, scene.skyBox->textureID);
   shaderProgram.uniformSetInt("cubemap", 0);
   glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
   glDepthFunc(GL_LESS);
 }
 
@@ -189,7 +410,7 @@ void Render::renderCube() {
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     // link vertex attributes
-    glBindVertexArray(cubeVAO);
+    GLState::bindVertexArray(cubeVAO);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)0);
@@ -200,43 +421,39 @@ void Render::renderCube() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)(6 * sizeof(float)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
   }
   // render Cube
-  glBindVertexArray(cubeVAO);
+  GLState::bindVertexArray(cubeVAO);
   glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0);
 }
 
 GLuint Render::quadVAO = 0;
 GLuint Render::quadVBO = 0;
 
 void Render::deferredRender(ShaderProgram &shader, Scene &scene) {
+  GLDebugGroup group("tone mapping");
   std::vector<GLuint> deferredTex = scene.deferredTex;
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, scene.deferredTex[0]);
+  GLState::bindTexture(0, GL_TEXTURE_2D, scene.deferredTex[0]);
   shader.uniformSetInt("deferredTex", 0);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, scene.pingpongColorBuffers[0]);
+  GLState::bindTexture(1, GL_TEXTURE_2D, scene.pingpongColorBuffers[0]);
   shader.uniformSetInt("bloomBlur", 1);
 
   shader.uniformSetBool("isHdr", true);
   shader.uniformSetBool("isBloom", true);
   shader.uniformSetFloat("exposure", scene.camera->exposure);
   renderQuad();
-  std::cout << "renderQuad:" << glGetError() << std::endl;
 }
 
 void Render::renderBlur(ShaderProgram &shader, Scene &scene) {
+  GLDebugGroup group("bloom blur");
   bool horizontal = true, firstIter = true;
   unsigned int amount = 10;
   for (unsigned int i = 0; i < amount; ++i) {
-    glBindFramebuffer(GL_FRAMEBUFFER, scene.pingpongFBO[horizontal]);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, scene.pingpongFBO[horizontal]);
     shader.uniformSetBool("horizontal", horizontal);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, firstIter
-                                     ? scene.deferredTex[1]
-                                     : scene.pingpongColorBuffers[!horizontal]);
+    GLState::bindTexture(0, GL_TEXTURE_2D,
+                         firstIter ? scene.deferredTex[1]
+                                   : scene.pingpongColorBuffers[!horizontal]);
     shader.uniformSetInt("image", 0);
     renderQuad();
     horizontal = !horizontal;
@@ -244,8 +461,7 @@ void Render::renderBlur(ShaderProgram &shader, Scene &scene) {
       firstIter = false;
     }
   }
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  std::cout << "renderBlur:" << glGetError() << std::endl;
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Render::renderQuad() {
@@ -255,7 +471,7 @@ void Render::renderQuad() {
         1.0f,  1.0f, 0.0f, 1.0f, 1.0f, 1.0f,  -1.0f, 0.0f, 1.0f, 0.0f,
     };
     glGenVertexArrays(1, &quadVAO);
-    glBindVertexArray(quadVAO);
+    GLState::bindVertexArray(quadVAO);
     glGenBuffers(1, &quadVBO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
@@ -267,28 +483,28 @@ void Render::renderQuad() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
                           (void *)(3 * sizeof(float)));
   }
-  glBindVertexArray(quadVAO);
+  GLState::bindVertexArray(quadVAO);
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-  glBindVertexArray(0);
 }
 
 void Render::renderGBuffer(ShaderProgram &shaderProgram, Scene &scene) {
+  GLDebugGroup group("G-buffer");
   scene.gBuffer.bind();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  render(scene, shaderProgram, false, true, false);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  std::cout << "renderGBuffer:" << glGetError() << std::endl;
+  render(scene, shaderProgram, false, true, false, RenderPass::GBUFFER);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Render::renderLightPass(ShaderProgram &shaderProgram, Scene &scene) {
-  glDisable(GL_DEPTH_TEST);
+  GLDebugGroup group("light pass");
+  GLState::disable(GL_DEPTH_TEST);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  shaderProgram.uniformSetVec3F("viewPos", scene.camera->getPosition());
+  shaderProgram.uniformSetVec3F(VIEW_POS, scene.camera->getPosition());
   scene.gBuffer.configure(shaderProgram);
-  configureLights(scene.lights, shaderProgram);
+  configureLights(scene, shaderProgram);
+  for (Light *light : scene.lights) {
+    light->activeShadowTex();
+  }
   renderQuad();
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glEnable(GL_DEPTH_TEST);
-  std::cout << "renderLightPass:" << glGetError() << std::endl;
+  GLState::enable(GL_DEPTH_TEST);
 }
\ No newline at end of file
@@ -2,22 +2,41 @@
 #ifndef OPENGL_RENDER_H
 #define OPENGL_RENDER_H
 
+#include "../scene/occlusionculler.h"
 #include "../scene/scene.h"
+#include "../utils/threadpool.h"
+#include "commandlist.h"
 #include "displaymanager.h"
+#include "geometrybuffer.h"
+#include "gpuculler.h"
+#include "renderqueue.h"
 #include "shader.h"
+#include "uniformring.h"
+#include <memory>
 #include <set>
 
 const unsigned int SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
 
 class Render {
 public:
+  // uniform block binding of Matrices
+  static const GLuint MATRICES_BINDING = 0;
+
   static void prepare(Camera *camera, DisplayManager &displayManager);
   static void renderShadowMap(Scene &scene, ShaderProgram &shaderProgram,
                               std::set<LightType> &lightTypes);
   static void debugRenderShadowMap(Scene &scene, ShaderProgram &shaderProgram);
+  // mesh instances outside frustum, the camera's when null, are skipped.
+  // with gpu culling on, the directional shadow and G-buffer passes cull
+  // and build their draws in a compute shader. every other pass, and those
+  // without it, go through the BVH query, the queue sorted by state and the
+  // command lists; there the G-buffer pass also drops occluded meshes and
+  // draws front to back. point light shadows use renderSphere
   static void render(Scene &scene, ShaderProgram &shaderProgram,
                      bool withLights = false, bool withMaterials = false,
-                     bool withShadowMap = false);
+                     bool withShadowMap = false,
+                     RenderPass pass = RenderPass::FORWARD,
+                     const Frustum *frustum = nullptr);
   static void renderSkyBox(Scene &scene, ShaderProgram &shaderProgram);
   static void renderLight(ShaderProgram &shader, glm::vec3 &lightPos,
                           glm::vec3 &diffuse);
@@ -25,16 +44,76 @@ public:
   static void renderBlur(ShaderProgram &shader, Scene &scene);
   static void renderGBuffer(ShaderProgram &shaderProgram, Scene &scene);
   static void renderLightPass(ShaderProgram &shaderProgram, Scene &scene);
+  // mesh instances culled by a pass since the last endFrame. passes on the
+  // gpu path report theirs a frame or two late
+  static unsigned int culledMeshes(RenderPass pass);
+  // mesh instances the gpu path drew for a pass, a frame or two late. non
+  // zero only where the compute culling actually ran
+  static unsigned int gpuDrawnMeshes(RenderPass pass);
+  // wall time of recording the command lists of a pass, and the jobs it
+  // was split into, since the last endFrame. cpu path only
+  static double recordMilliseconds(RenderPass pass);
+  static unsigned int recordJobCount(RenderPass pass);
+  // G-buffer pass occlusion test counts since the last endFrame
+  static const OcclusionCuller &occlusion();
+  // also hands the uniform ring over to the next frame
+  static void endFrame();
+  // the cull compute shader where GLExt::hasGpuCulling, null for the cpu
+  // path. gBuffer false keeps the G-buffer pass on the cpu, trading the
+  // per mesh walk for the occlusion test and front to back order
+  static void setGpuCulling(ShaderProgram *cullProgram, bool gBuffer = true);
+  static void cleanUp();
   static GLuint cubeVAO;
   static GLuint cubeVBO;
   static GLuint quadVAO;
   static GLuint quadVBO;
 
 private:
-  static void configureLights(std::vector<Light *> &lights,
-                              ShaderProgram &shaderProgram);
+  static void configureLights(Scene &scene, ShaderProgram &shaderProgram);
   static void renderCube();
   static void renderQuad();
+  // the shadow pass of a light with a shadowSphere, on the cpu path with
+  // the BVH sphere query
+  static void renderSphere(Scene &scene, ShaderProgram &shaderProgram,
+                           const glm::vec3 &center, float radius);
+  // submits, sorts, records and replays the items of visibleItems
+  static void drawVisible(Scene &scene, ShaderProgram &shaderProgram,
+                          bool withMaterials, RenderPass pass);
+  // submits a packet per mesh with at least one instance in visibleItems.
+  // the G-buffer pass first drops what the occluders hide
+  static void submitMeshes(Scene &scene, GLuint program, bool withMaterials,
+                           RenderPass pass);
+  // records the sorted packets into commandLists[0], ranges of them in
+  // parallel on the workers. returns the number of jobs
+  static size_t recordPackets(Scene &scene, ShaderProgram &shaderProgram,
+                              bool withMaterials);
+  // one DrawRecord per visible instance and one draw per packet of
+  // [first, last), materials where they change. no GL calls
+  static void recordRange(Scene &scene, size_t first, size_t last,
+                          bool withMaterials, CommandList &commandList);
+  static ThreadPool &workers();
+
+  // reused by every pass, they keep their memory across frames
+  static RenderQueue queue;
+  static std::vector<uint32_t> visibleItems;
+  static OcclusionCuller occlusionCuller;
+  static GpuCuller gpuCuller;
+  // gpu culled counts that came back, added into culled and gpuDrawn
+  static std::vector<CullCount> cullCounts;
+  static bool gpuCullGBuffer;
+  // indexed by RenderPass
+  static unsigned int gpuDrawn[3];
+  static double recordTime[3];
+  static unsigned int recordJobs[3];
+  // scene wide instance indices, packets reference ranges of it
+  static std::vector<uint32_t> visibleInstances;
+  // indexed by RenderPass
+  static unsigned int culled[3];
+  // one per recording job, the first one is replayed
+  static std::vector<CommandList> commandLists;
+  static std::unique_ptr<ThreadPool> pool;
+  // per pass uniform blocks, fenced per frame by endFrame
+  static UniformRing uniformRing;
 };
 
 #endif // OPENGL_RENDER_H
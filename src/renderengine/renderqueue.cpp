@@ -0,0 +1,73 @@
+
+#include "renderqueue.h"
+#include <algorithm>
+
+namespace {
+
+const int PASS_SHIFT = 60;
+const int PROGRAM_SHIFT = 52;
+const int LAYER_SHIFT = 48;
+const int MATERIAL_SHIFT = 32;
+const int TEXTURE_SET_SHIFT = 20;
+
+const uint64_t PROGRAM_MASK = 0xff;
+const uint64_t LAYER_MASK = 0xf;
+const uint64_t MATERIAL_MASK = 0xffff;
+const uint64_t TEXTURE_SET_MASK = 0xfff;
+const uint64_t DEPTH_MASK = 0xfffff;
+
+const int RADIX_BITS = 8;
+const int RADIX_SIZE = 1 << RADIX_BITS;
+
+} // namespace
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program,
+                              unsigned int material, unsigned int textureSet,
+                              float depth, bool frontToBack) {
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+  uint64_t key = uint64_t(pass) << PASS_SHIFT;
+  key |= (program & PROGRAM_MASK) << PROGRAM_SHIFT;
+  if (frontToBack) {
+    key |= uint64_t(depth * LAYER_MASK + 0.5f) << LAYER_SHIFT;
+  }
+  key |= std::min<uint64_t>(material, MATERIAL_MASK) << MATERIAL_SHIFT;
+  key |= (textureSet & TEXTURE_SET_MASK) << TEXTURE_SET_SHIFT;
+  key |= uint64_t(depth * DEPTH_MASK);
+  return key;
+}
+
+void RenderQueue::clear() { items.clear(); }
+
+void RenderQueue::submit(uint64_t key, Mesh *mesh, uint32_t firstInstance,
+                         uint32_t instanceCount) {
+  items.push_back(DrawPacket{key, mesh, firstInstance, instanceCount});
+}
+
+void RenderQueue::sort() {
+  if (items.size() < 2) {
+    return;
+  }
+  scratch.resize(items.size());
+  size_t counts[RADIX_SIZE];
+  for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+    std::fill(counts, counts + RADIX_SIZE, 0);
+    for (const DrawPacket &packet : items) {
+      ++counts[(packet.key >> shift) & (RADIX_SIZE - 1)];
+    }
+    if (counts[(items[0].key >> shift) & (RADIX_SIZE - 1)] == items.size()) {
+      continue;
+    }
+    size_t offset = 0;
+    for (int digit = 0; digit < RADIX_SIZE; ++digit) {
+      size_t count = counts[digit];
+      counts[digit] = offset;
+      offset += count;
+    }
+    for (const DrawPacket &packet : items) {
+      scratch[counts[(packet.key >> shift) & (RADIX_SIZE - 1)]++] = packet;
+    }
+    items.swap(scratch);
+  }
+}
+
+const std::vector<DrawPacket> &RenderQueue::packets() const { return items; }
@@ -0,0 +1,53 @@
+
+#ifndef OPENGL_RENDERQUEUE_H
+#define OPENGL_RENDERQUEUE_H
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <vector>
+
+class Mesh;
+
+// highest bits of the sort key, passes never interleave
+enum class RenderPass { SHADOW, GBUFFER, FORWARD };
+
+// a mesh and the range of its visible instances in the submitting pass's
+// instance list
+struct DrawPacket {
+  uint64_t key;
+  Mesh *mesh;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+/**
+ * draws of one or more passes, sorted by a packed 64-bit key before they are
+ * submitted. from the highest bit down:
+ *   pass 4 | program 8 | depth layer 4 | material 16 | texture set 12 |
+ *   depth 20
+ * so that draws sharing a program, material and textures end up next to
+ * each other. the depth layer is only filled for front to back passes: near
+ * layers are drawn first for early-z, state is still grouped inside a layer.
+ * the queue keeps its memory across frames, clear() it before each pass.
+ */
+class RenderQueue {
+public:
+  // depth is the normalized distance in [0, 1]
+  static uint64_t makeKey(RenderPass pass, GLuint program,
+                          unsigned int material, unsigned int textureSet,
+                          float depth, bool frontToBack);
+
+  void clear();
+  void submit(uint64_t key, Mesh *mesh, uint32_t firstInstance,
+              uint32_t instanceCount);
+  // stable LSD radix sort, 8 bits per round, skips rounds where every key
+  // has the same digit
+  void sort();
+  const std::vector<DrawPacket> &packets() const;
+
+private:
+  std::vector<DrawPacket> items;
+  std::vector<DrawPacket> scratch;
+};
+
+#endif // OPENGL_RENDERQUEUE_H
@@ -2,11 +2,28 @@
 #include "shader.h"
 #include "GLFW/glfw3.h"
 #include "glad/glad.h"
+#include "gldebug.h"
+#include "glstate.h"
 #include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <sstream>
 
+namespace {
+
+// names interned so far, position is the UniformID
+std::vector<std::string> &internedNames() {
+  static std::vector<std::string> names;
+  return names;
+}
+
+std::unordered_map<std::string, UniformID> &internedIDs() {
+  static std::unordered_map<std::string, UniformID> ids;
+  return ids;
+}
+
+} // namespace
+
 ShaderInfo::ShaderInfo(GLenum sType, std::string fPath) {
   shaderType = sType;
   filePath = fPath;
@@ -50,13 +67,82 @@ void ShaderProgram::createProgram() {
     glAttachShader(programID, shader);
   }
 
-  std::cout << "shader:" << glGetError() << std::endl;
-
   glLinkProgram(programID);
   checkCompileErrors(programID, NULL);
+  std::string label;
+  for (const ShaderInfo &shaderInfo : shaders) {
+    label += (label.empty() ? "" : " + ") + shaderInfo.filePath;
+  }
+  GLDebug::label(GL_PROGRAM, programID, label.c_str());
+  reflectUniforms();
+}
+
+void ShaderProgram::reflectUniforms() {
+  locationTable.clear();
+  locations.clear();
+  GLint uniformCount = 0, maxLength = 0;
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<GLchar> nameBuffer(maxLength + 1);
+  for (GLint i = 0; i < uniformCount; ++i) {
+    GLint size = 0;
+    GLenum type;
+    GLsizei length = 0;
+    glGetActiveUniform(programID, i, nameBuffer.size(), &length, &size, &type,
+                       nameBuffer.data());
+    std::string name(nameBuffer.data(), length);
+    GLint location = glGetUniformLocation(programID, name.c_str());
+    // uniforms inside blocks have no location
+    if (location < 0) {
+      continue;
+    }
+    locationTable[name] = location;
+    // arrays are reported as name[0], register the bare name and every
+    // element so that name, name[0] and name[i] all resolve
+    size_t bracket = name.rfind("[0]");
+    if (bracket == std::string::npos || bracket + 3 != name.size()) {
+      continue;
+    }
+    std::string base = name.substr(0, bracket);
+    locationTable[base] = location;
+    for (GLint element = 1; element < size; ++element) {
+      std::string elementName = base + "[" + std::to_string(element) + "]";
+      locationTable[elementName] =
+          glGetUniformLocation(programID, elementName.c_str());
+    }
+  }
 }
 
-void ShaderProgram::use() { glUseProgram(programID); }
+UniformID ShaderProgram::uniformID(const std::string &name) {
+  std::unordered_map<std::string, UniformID> &ids = internedIDs();
+  std::unordered_map<std::string, UniformID>::iterator it = ids.find(name);
+  if (it != ids.end()) {
+    return it->second;
+  }
+  UniformID id = internedNames().size();
+  internedNames().push_back(name);
+  ids[name] = id;
+  return id;
+}
+
+GLint ShaderProgram::uniformLocation(UniformID id) {
+  // names interned after the last lookup are resolved once, in bulk
+  if (id >= locations.size()) {
+    const std::vector<std::string> &names = internedNames();
+    for (size_t i = locations.size(); i < names.size(); ++i) {
+      locations.push_back(uniformLocation(names[i]));
+    }
+  }
+  return locations[id];
+}
+
+GLint ShaderProgram::uniformLocation(const std::string &name) const {
+  std::unordered_map<std::string, GLint>::const_iterator it =
+      locationTable.find(name);
+  return it == locationTable.end() ? -1 : it->second;
+}
+
+void ShaderProgram::use() { GLState::useProgram(programID); }
 
 void ShaderProgram::cleanUp() {
   for (unsigned int i = 0; i < shaders.size(); ++i) {
@@ -90,31 +176,53 @@ void ShaderProgram::checkCompileErrors(unsigned int shader, GLenum type) {
   }
 }
 
+void ShaderProgram::uniformSetVec3F(UniformID id, glm::vec3 value) {
+  glUniform3f(uniformLocation(id), value.x, value.y, value.z);
+}
+
+void ShaderProgram::uniformSetVec4F(UniformID id, glm::vec4 value) {
+  glUniform4f(uniformLocation(id), value.x, value.y, value.z, value.w);
+}
+
+void ShaderProgram::uniformSetInt(UniformID id, int value) {
+  glUniform1i(uniformLocation(id), value);
+}
+
+void ShaderProgram::uniformSetFloat(UniformID id, float value) {
+  glUniform1f(uniformLocation(id), value);
+}
+
+void ShaderProgram::uniformSetMat4(UniformID id, const glm::mat4 &value) {
+  glUniformMatrix4fv(uniformLocation(id), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::uniformSetBool(UniformID id, bool value) {
+  glUniform1i(uniformLocation(id), value);
+}
+
 void ShaderProgram::uniformSetVec3F(const std::string name, glm::vec3 value) {
-  glUniform3f(glGetUniformLocation(programID, name.c_str()), value.x, value.y,
-              value.z);
+  glUniform3f(uniformLocation(name), value.x, value.y, value.z);
 }
 
 void ShaderProgram::uniformSetVec4F(const std::string name, glm::vec4 value) {
-  glUniform4f(glGetUniformLocation(programID, name.c_str()), value.x, value.y,
-              value.z, value.w);
+  glUniform4f(uniformLocation(name), value.x, value.y, value.z, value.w);
 }
 
 void ShaderProgram::uniformSetInt(const std::string name, int value) {
-  glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+  glUniform1i(uniformLocation(name), value);
 }
 
 void ShaderProgram::uniformSetFloat(const std::string name, float value) {
-  glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+  glUniform1f(uniformLocation(name), value);
 }
 
 void ShaderProgram::uniformSetMat4(const std::string name, glm::mat4 &value) {
-  glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE,
+  glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE,
                      glm::value_ptr(value));
 }
 
 void ShaderProgram::uniformSetBool(const std::string name, bool value) {
-  glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+  glUniform1i(uniformLocation(name), value);
 }
 
 void ShaderProgram::bindUniformBlock(const std::string name, int value) {
@@ -1,9 +1,11 @@
+
 #ifndef OPENGL_SHADER_H
 #define OPENGL_SHADER_H
 
 #include <glad/glad.h>
 #include <glm/mat4x4.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class ShaderInfo {
@@ -14,13 +16,29 @@ public:
   ShaderInfo(GLenum sType, std::string fPath);
 };
 
+// an interned uniform name, valid in every program. resolve it once with
+// ShaderProgram::uniformID and keep it, lookups are then an array index
+typedef unsigned int UniformID;
+
 class ShaderProgram {
 public:
   GLuint programID;
   ShaderProgram(std::vector<ShaderInfo> &shaders);
   void use();
   void cleanUp();
-  // set uniform values
+  // interns name, the same name always maps to the same id. GL thread only
+  static UniformID uniformID(const std::string &name);
+  // -1 when the program has no such active uniform, like glGetUniformLocation
+  GLint uniformLocation(UniformID id);
+  GLint uniformLocation(const std::string &name) const;
+  // set uniform values, by pre-resolved id on hot paths
+  void uniformSetVec3F(UniformID id, glm::vec3 value);
+  void uniformSetVec4F(UniformID id, glm::vec4 value);
+  void uniformSetInt(UniformID id, int value);
+  void uniformSetFloat(UniformID id, float value);
+  void uniformSetMat4(UniformID id, const glm::mat4 &value);
+  void uniformSetBool(UniformID id, bool value);
+  // or by name through the reflected table, no driver round trip
   void uniformSetVec3F(const std::string name, glm::vec3 value);
   void uniformSetVec4F(const std::string name, glm::vec4 value);
   void uniformSetInt(const std::string name, int value);
@@ -32,7 +50,12 @@ public:
 private:
   void checkCompileErrors(unsigned int shader, GLenum type);
   void createProgram();
+  // fills locationTable from the active uniforms after linking
+  void reflectUniforms();
   std::vector<ShaderInfo> shaders;
+  std::unordered_map<std::string, GLint> locationTable;
+  // indexed by UniformID, grown on demand as new names get interned
+  std::vector<GLint> locations;
 };
 
 #endif // OPENGL_SHADER_H
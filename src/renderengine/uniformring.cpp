@@ -0,0 +1,133 @@
+#include "uniformring.h"
+#include "gldebug.h"
+#include "glext.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// 1 second, in nanoseconds, per glClientWaitSync round
+const GLuint64 FENCE_TIMEOUT = 1000000000;
+} // namespace
+
+UniformRing::UniformRing(GLsizeiptr frameCapacity)
+    : frameCapacity(frameCapacity) {}
+
+UniformRange UniformRing::write(const void *data, GLsizeiptr bytes) {
+  GLsizeiptr offset = (used + alignment - 1) / alignment * alignment;
+  if (buffer == 0 || offset + bytes > frameCapacity) {
+    // the first write, or a frame needs more: the old buffer stays alive,
+    // so blocks already bound from it keep their binding and contents
+    allocate(buffer == 0 ? std::max(frameCapacity, bytes)
+                         : std::max(2 * frameCapacity, offset + bytes));
+    offset = 0;
+  }
+  GLintptr position = frame * frameCapacity + offset;
+  if (mapped) {
+    memcpy(mapped + position, data, bytes);
+  } else {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, position, bytes, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+  used = offset + bytes;
+  return UniformRange{buffer, position, bytes};
+}
+
+void UniformRing::bind(GLuint binding, const UniformRange &range) {
+  glBindBufferRange(GL_UNIFORM_BUFFER, binding, range.buffer, range.offset,
+                    range.size);
+}
+
+void UniformRing::endFrame() {
+  if (buffer == 0) {
+    return;
+  }
+  fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  releaseRetired();
+  frame = (frame + 1) % FRAME_NUM;
+  used = 0;
+  GLsync &fence = fences[frame];
+  if (fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                            FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+}
+
+void UniformRing::allocate(GLsizeiptr regionBytes) {
+  GLint offsetAlignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+  alignment = std::max(offsetAlignment, 1);
+  frameCapacity = (regionBytes + alignment - 1) / alignment * alignment;
+  // the old fences guard a buffer nobody writes to anymore, the retired
+  // entry's fence covers its last reads
+  clearFences();
+  if (buffer != 0) {
+    retired.push_back(Retired{buffer, nullptr});
+  }
+  buffer = 0;
+  mapped = nullptr;
+  used = 0;
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  GLsizeiptr bytes = FRAME_NUM * frameCapacity;
+  if (GLExt::hasBufferStorage()) {
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLExt::bufferStorage(GL_UNIFORM_BUFFER, bytes, NULL, flags);
+    mapped = static_cast<unsigned char *>(
+        glMapBufferRange(GL_UNIFORM_BUFFER, 0, bytes, flags));
+  } else {
+    glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  GLDebug::label(GL_BUFFER, buffer, "uniform ring");
+}
+
+void UniformRing::clearFences() {
+  for (GLsync &fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+}
+
+void UniformRing::releaseRetired() {
+  size_t kept = 0;
+  for (Retired &old : retired) {
+    if (!old.fence) {
+      old.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else if (glClientWaitSync(old.fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+      glDeleteSync(old.fence);
+      // deleting unmaps a persistently mapped one
+      glDeleteBuffers(1, &old.buffer);
+      continue;
+    }
+    retired[kept++] = old;
+  }
+  retired.resize(kept);
+}
+
+void UniformRing::cleanUp() {
+  clearFences();
+  for (Retired &old : retired) {
+    if (old.fence) {
+      glDeleteSync(old.fence);
+    }
+    glDeleteBuffers(1, &old.buffer);
+  }
+  retired.clear();
+  if (buffer != 0) {
+    // deleting unmaps, the storage lives on while draws still read it
+    glDeleteBuffers(1, &buffer);
+  }
+  buffer = 0;
+  mapped = nullptr;
+  used = 0;
+}
+
+GLsizeiptr UniformRing::capacity() const { return frameCapacity; }
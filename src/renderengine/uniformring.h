@@ -0,0 +1,70 @@
+
+#ifndef OPENGL_UNIFORMRING_H
+#define OPENGL_UNIFORMRING_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// where write() put a block, valid until the region is reused
+struct UniformRange {
+  GLuint buffer;
+  GLintptr offset;
+  GLsizeiptr size;
+};
+
+/**
+ * one uniform buffer split into FRAME_NUM regions, one per frame in
+ * flight. uniform blocks are appended to the current frame's region at
+ * GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and bound with glBindBufferRange, no
+ * buffer is created or resized per draw. endFrame() fences the region and
+ * moves on, waiting only if the GPU is still FRAME_NUM - 1 frames behind.
+ * with buffer storage (4.4) the buffer is mapped persistent and coherent
+ * and write() is a memcpy, else a glBufferSubData into a region the GPU is
+ * done with. a frame that overflows its region doubles the buffer once,
+ * memory then stays flat. the old buffer is not deleted right away, that
+ * would unbind the ranges already bound from it this frame: it is fenced
+ * at the end of the frame and deleted once the GPU passed the fence.
+ * GL thread only.
+ */
+class UniformRing {
+public:
+  static const int FRAME_NUM = 3;
+
+  explicit UniformRing(GLsizeiptr frameCapacity);
+  UniformRing(const UniformRing &) = delete;
+  UniformRing &operator=(const UniformRing &) = delete;
+
+  // copies bytes of data into this frame's region
+  UniformRange write(const void *data, GLsizeiptr bytes);
+  static void bind(GLuint binding, const UniformRange &range);
+  void endFrame();
+  void cleanUp();
+  // bytes of one frame region
+  GLsizeiptr capacity() const;
+
+private:
+  // a new buffer of FRAME_NUM regions, the old one is retired
+  void allocate(GLsizeiptr regionBytes);
+  void clearFences();
+  // fences the buffers retired this frame, deletes those the GPU is done
+  // with
+  void releaseRetired();
+
+  // a replaced buffer, fence is null until the frame that replaced it ends
+  struct Retired {
+    GLuint buffer;
+    GLsync fence;
+  };
+
+  GLuint buffer = 0;
+  // persistent mapping of the whole buffer, null without buffer storage
+  unsigned char *mapped = nullptr;
+  GLsizeiptr frameCapacity;
+  GLsizeiptr used = 0;
+  GLint alignment = 256;
+  int frame = 0;
+  GLsync fences[FRAME_NUM] = {};
+  std::vector<Retired> retired;
+};
+
+#endif // OPENGL_UNIFORMRING_H
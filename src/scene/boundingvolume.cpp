@@ -0,0 +1,30 @@
+
+#include "boundingvolume.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+
+BoundingSphere BoundingSphere::compute(const Vertex *vertices,
+                                       unsigned int vertexCount,
+                                       const VertexBounds &bounds) {
+  BoundingSphere sphere;
+  sphere.center = (bounds.min + bounds.max) * 0.5f;
+  float radiusSquared = 0.0f;
+  for (unsigned int i = 0; i < vertexCount; ++i) {
+    glm::vec3 offset = vertices[i].position - sphere.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  sphere.radius = std::sqrt(radiusSquared);
+  return sphere;
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4 &transform) const {
+  BoundingSphere sphere;
+  sphere.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+  float scale = std::max(std::max(glm::length(glm::vec3(transform[0])),
+                                  glm::length(glm::vec3(transform[1]))),
+                         glm::length(glm::vec3(transform[2])));
+  sphere.radius = radius * scale;
+  return sphere;
+}
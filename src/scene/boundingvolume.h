@@ -0,0 +1,24 @@
+
+#ifndef OPENGL_BOUNDINGVOLUME_H
+#define OPENGL_BOUNDINGVOLUME_H
+
+#include "vertexformat.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+struct Vertex;
+
+// encloses a mesh, in model space until transformed
+struct BoundingSphere {
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = 0.0f;
+
+  // centered on the AABB, so it is not the tightest sphere but one pass
+  static BoundingSphere compute(const Vertex *vertices,
+                                unsigned int vertexCount,
+                                const VertexBounds &bounds);
+  // the radius grows with the largest axis scale of transform
+  BoundingSphere transformed(const glm::mat4 &transform) const;
+};
+
+#endif // OPENGL_BOUNDINGVOLUME_H
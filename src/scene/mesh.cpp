@@ -1,92 +1,163 @@
 
 #include "mesh.h"
+#include "../material/materialtable.h"
 #include <iostream>
-Mesh::Mesh(std::string name, const std::vector<Vertex> &vertices,
-           const std::vector<unsigned int> &indices,
-           const std::vector<Material> &materials)
-    : name(name), vertices(vertices), indices(indices), materials(materials) {
-  loadData();
+
+Mesh::Mesh(std::string name, std::vector<Vertex> &&vertices,
+           std::vector<unsigned int> &&indices,
+           std::vector<Material> &&materials)
+    : vertices(std::move(vertices)), indices(std::move(indices)),
+      materials(std::move(materials)), name(std::move(name)) {
+  loadData(this->vertices.data(), this->vertices.size(),
+           this->indices.data(), this->indices.size());
 }
 
-void Mesh::loadData() {
-  create();
-  storeData();
-  unbind();
+Mesh::Mesh(MeshData &&data)
+    : vertices(std::move(data.vertices)), indices(std::move(data.indices)),
+      materials(std::move(data.materials)), name(std::move(data.name)),
+      bounds(data.bounds), sphere(data.sphere) {
+  loadData(vertices.data(), vertices.size(), indices.data(), indices.size(),
+           false);
 }
 
-void Mesh::draw(ShaderProgram &shaderProgram, bool withMaterials,
-                std::vector<Light *> &lights) {
-  glBindVertexArray(VAO);
-  for (unsigned int i = 0; i < ATTRIBUTE_NUM; ++i) {
-    glEnableVertexAttribArray(i);
-  }
+Mesh::Mesh(std::string name, const Vertex *vertexData,
+           unsigned int vertexCount, const unsigned int *indexData,
+           unsigned int indexCount, std::vector<Material> &&materials)
+    : materials(std::move(materials)),
+      residency(GeometryResidency::RELEASE), name(std::move(name)) {
+  loadData(vertexData, vertexCount, indexData, indexCount);
+}
 
-  for (Light *light : lights) {
-    light->activeShadowTex();
+Mesh::Mesh(Mesh &&other) noexcept
+    : vertices(std::move(other.vertices)), indices(std::move(other.indices)),
+      positions(std::move(other.positions)),
+      materials(std::move(other.materials)), baseVertex(other.baseVertex),
+      firstIndex(other.firstIndex), vertexCount(other.vertexCount),
+      indexCount(other.indexCount), residency(other.residency),
+      name(std::move(other.name)), bounds(other.bounds),
+      sphere(other.sphere), occluder(other.occluder) {
+  // the moved-from mesh no longer owns anything
+  other.vertexCount = other.indexCount = 0;
+  other.materials.clear();
+}
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept {
+  if (this != &other) {
+    cleanUp();
+    vertices = std::move(other.vertices);
+    indices = std::move(other.indices);
+    positions = std::move(other.positions);
+    materials = std::move(other.materials);
+    baseVertex = other.baseVertex;
+    firstIndex = other.firstIndex;
+    vertexCount = other.vertexCount;
+    indexCount = other.indexCount;
+    residency = other.residency;
+    name = std::move(other.name);
+    bounds = other.bounds;
+    sphere = other.sphere;
+    occluder = other.occluder;
+    other.vertexCount = other.indexCount = 0;
+    other.materials.clear();
   }
+  return *this;
+}
 
-  textureIndex = lights.size();
+Mesh::~Mesh() { cleanUp(); }
 
-  if (withMaterials) {
-    for (unsigned int j = 0; j < materials.size(); ++j) {
-      materials[j].configure(shaderProgram, j, textureIndex);
-    }
+void Mesh::loadData(const Vertex *vertexData, unsigned int vertexNum,
+                    const unsigned int *indexData, unsigned int indexNum,
+                    bool computeBounds) {
+  vertexCount = vertexNum;
+  indexCount = indexNum;
+  if (computeBounds) {
+    bounds = VertexFormat::computeBounds(vertexData, vertexCount);
+    sphere = BoundingSphere::compute(vertexData, vertexCount, bounds);
   }
-
-  if (!indices.empty()) {
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-  } else {
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
+  for (Material &material : materials) {
+    material.tableIndex = MaterialTable::add(material);
+    material.textureSetIndex = MaterialTable::addTextureSet(material);
   }
+  storeData(vertexData, indexData);
+}
 
-  for (unsigned int i = 0; i < ATTRIBUTE_NUM; ++i) {
-    glDisableVertexAttribArray(i);
-  }
-  glBindVertexArray(0);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-  glActiveTexture(GL_TEXTURE0);
-  textureIndex = 0;
+DrawElementsIndirectCommand Mesh::drawCommand(GLuint baseInstance,
+                                              GLuint instanceCount) const {
+  return DrawElementsIndirectCommand{indexCount, instanceCount, firstIndex,
+                                     baseVertex, baseInstance};
 }
 
-void Mesh::create() {
-  glGenVertexArrays(1, &VAO);
-  glBindVertexArray(VAO);
+void Mesh::storeData(const Vertex *vertexData,
+                     const unsigned int *indexData) {
+  std::vector<PackedVertex> packed =
+      VertexFormat::pack(vertexData, vertexCount, bounds);
+  // the shared buffer is indexed throughout
+  std::vector<unsigned int> sequential;
+  if (indexCount == 0) {
+    sequential.resize(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+      sequential[i] = i;
+    }
+    indexData = sequential.data();
+    indexCount = vertexCount;
+  }
+  GeometryBuffer::add(packed.data(), vertexCount, indexData, indexCount,
+                      baseVertex, firstIndex);
 }
 
-void Mesh::storeData() {
-  glGenBuffers(1, &VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0],
-               GL_STATIC_DRAW);
+void Mesh::setResidency(GeometryResidency residency) {
+  if (residency == GeometryResidency::POSITIONS && positions.empty()) {
+    positions.reserve(vertices.size());
+    for (const Vertex &vertex : vertices) {
+      positions.push_back(vertex.position);
+    }
+  } else if (residency != GeometryResidency::POSITIONS) {
+    std::vector<glm::vec3>().swap(positions);
+  }
+  if (residency != GeometryResidency::KEEP) {
+    // swap instead of clear, so the memory is actually returned
+    std::vector<Vertex>().swap(vertices);
+  }
+  if (residency == GeometryResidency::RELEASE) {
+    std::vector<unsigned int>().swap(indices);
+  }
+  this->residency = residency;
+}
 
-  // EBO
-  if (!indices.empty()) {
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
+void Mesh::retain(const Vertex *vertexData, const unsigned int *indexData,
+                  GeometryResidency residency) {
+  if (residency == GeometryResidency::KEEP) {
+    vertices.assign(vertexData, vertexData + vertexCount);
+  } else if (residency == GeometryResidency::POSITIONS) {
+    positions.resize(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; ++i) {
+      positions[i] = vertexData[i].position;
+    }
+  }
+  // storeData made indexCount == vertexCount for an unindexed blob, readers
+  // treat empty indices as sequential
+  if (residency != GeometryResidency::RELEASE && indexData) {
+    indices.assign(indexData, indexData + indexCount);
   }
+  this->residency = residency;
+}
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, normal));
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, textureCoord));
-  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, tangent));
-  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, bitangent));
+size_t Mesh::gpuBytes() const {
+  return size_t(vertexCount) * sizeof(PackedVertex) +
+         size_t(indexCount) * sizeof(GLuint);
 }
 
-void Mesh::unbind() {
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+size_t Mesh::cpuBytes() const {
+  return vertices.capacity() * sizeof(Vertex) +
+         indices.capacity() * sizeof(unsigned int) +
+         positions.capacity() * sizeof(glm::vec3);
 }
 
 void Mesh::cleanUp() {
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  glDeleteBuffers(1, &EBO);
+  // the GeometryBuffer range stays allocated until GeometryBuffer::cleanUp
+  for (Material &material : materials) {
+    material.cleanUp();
+  }
+  // released once, a second cleanUp must not drop the references again
+  materials.clear();
 }
@@ -4,9 +4,13 @@
 
 #include "../light/light.h"
 #include "../material/material.h"
+#include "../renderengine/geometrybuffer.h"
 #include "../renderengine/shader.h"
+#include "boundingvolume.h"
+#include "vertexformat.h"
 #include <glm/vec3.hpp>
 #include <vector>
+// cpu side vertex, packed into PackedVertex when uploaded
 struct Vertex {
   glm::vec3 position;
   glm::vec3 normal;
@@ -15,32 +19,92 @@ struct Vertex {
   glm::vec3 bitangent;
 };
 
-constexpr unsigned int ATTRIBUTE_NUM = 3;
+// what a mesh keeps in RAM once its buffers are on the GPU
+enum class GeometryResidency {
+  RELEASE,  // nothing, the GPU copy is the only one
+  KEEP,     // full vertices and indices, e.g. for picking or physics
+  POSITIONS // positions and indices only
+};
+
+// cpu side result of the import, safe to build on worker threads; Mesh turns
+// it into GL objects on the context thread
+struct MeshData {
+  std::string name;
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<Material> materials;
+  // computed here so that the GL thread does not walk the vertices again
+  VertexBounds bounds;
+  BoundingSphere sphere;
+};
 
+/**
+ * a range of the shared GeometryBuffer plus its materials. move-only, so no
+ * two copies release the same texture references. cleanUp (or the
+ * destructor) must run while the context is alive.
+ */
 class Mesh {
 public:
   Mesh() = default;
-  ~Mesh() = default;
+  ~Mesh();
+  Mesh(const Mesh &) = delete;
+  Mesh &operator=(const Mesh &) = delete;
+  Mesh(Mesh &&other) noexcept;
+  Mesh &operator=(Mesh &&other) noexcept;
+  // deletes the GL objects and releases the material textures, idempotent
   void cleanUp();
-  Mesh(std::string name, const std::vector<Vertex> &vertices,
-       const std::vector<unsigned int> &indices,
-       const std::vector<Material> &materials);
-  void draw(ShaderProgram &shaderProgram, bool withMaterials,
-            std::vector<Light *> &lights);
+  Mesh(std::string name, std::vector<Vertex> &&vertices,
+       std::vector<unsigned int> &&indices, std::vector<Material> &&materials);
+  // takes over the buffers of a mesh built off the GL thread
+  explicit Mesh(MeshData &&data);
+  // upload straight from an external blob, e.g. a mapped mesh cache. keeps
+  // no cpu copy (GeometryResidency::RELEASE) until retain is called
+  Mesh(std::string name, const Vertex *vertexData, unsigned int vertexCount,
+       const unsigned int *indexData, unsigned int indexCount,
+       std::vector<Material> &&materials);
+  // draws this mesh's range instanceCount times, instance i reads
+  // DrawRecord baseInstance + i
+  DrawElementsIndirectCommand drawCommand(GLuint baseInstance,
+                                          GLuint instanceCount) const;
+  // drops (part of) the cpu copy, only call after everything that reads
+  // vertices/indices, e.g. MeshCache::write, is done
+  void setResidency(GeometryResidency residency);
+  // copies what residency keeps out of the blob the mesh was built from,
+  // indexData is null for an unindexed blob
+  void retain(const Vertex *vertexData, const unsigned int *indexData,
+              GeometryResidency residency);
+  // its share of the GeometryBuffer
+  size_t gpuBytes() const;
+  // geometry still held in RAM
+  size_t cpuBytes() const;
 
   std::vector<Vertex> vertices;
   std::vector<unsigned int> indices;
+  // only filled with GeometryResidency::POSITIONS
+  std::vector<glm::vec3> positions;
   std::vector<Material> materials;
-  unsigned int VAO, VBO, EBO;
+  // where the mesh starts in the GeometryBuffer
+  GLint baseVertex = 0;
+  GLuint firstIndex = 0;
+  // stay valid after the cpu copy is released
+  unsigned int vertexCount = 0;
+  unsigned int indexCount = 0;
+  GeometryResidency residency = GeometryResidency::KEEP;
   std::string name;
+  // model space AABB, also the quantization range of the packed positions
+  VertexBounds bounds;
+  // model space, what the culling tests
+  BoundingSphere sphere;
+  // drawn into the OcclusionCuller depth buffer, keeps at least its
+  // positions and indices in RAM
+  bool occluder = false;
 
 private:
-  void loadData();
-  void create();
-  void storeData();
-  void unbind();
+  void loadData(const Vertex *vertexData, unsigned int vertexNum,
+                const unsigned int *indexData, unsigned int indexNum,
+                bool computeBounds = true);
+  void storeData(const Vertex *vertexData, const unsigned int *indexData);
   void configureMaterials(ShaderProgram &shaderProgram);
-  int textureIndex = 0;
 };
 
 #endif // OPENGL_MESH_H
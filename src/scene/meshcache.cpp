@@ -0,0 +1,342 @@
+
+#include "meshcache.h"
+#include "../utils/fileutils.h"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MESH_CACHE_MAGIC[4] = {'M', 'C', 'H', 'E'};
+
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexSize;
+  uint32_t importFlags;
+  uint64_t sourceHash;
+  uint32_t meshCount;
+  uint32_t reserved;
+};
+
+struct MeshRecord {
+  uint32_t nameLength;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t textureCount;
+  float diffuse[3];
+  float specular[3];
+  float shininess;
+  float opacity;
+};
+
+struct TextureRecord {
+  uint32_t type;
+  uint32_t pathLength;
+};
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+// 64 bit FNV-1a, continued from hash
+uint64_t fnv1a(uint64_t hash, const unsigned char *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string directoryOf(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// the file names of every "mtllib" line of an OBJ
+void materialLibraries(const unsigned char *data, size_t size,
+                       std::vector<std::string> &names) {
+  static const char KEYWORD[] = "mtllib";
+  const size_t keywordLength = sizeof(KEYWORD) - 1;
+  size_t i = 0;
+  while (i < size) {
+    size_t lineEnd = i;
+    while (lineEnd < size && data[lineEnd] != '\n') {
+      ++lineEnd;
+    }
+    if (lineEnd - i > keywordLength &&
+        memcmp(data + i, KEYWORD, keywordLength) == 0 &&
+        isspace(data[i + keywordLength])) {
+      size_t p = i + keywordLength;
+      while (p < lineEnd) {
+        while (p < lineEnd && isspace(data[p])) {
+          ++p;
+        }
+        size_t nameStart = p;
+        while (p < lineEnd && !isspace(data[p])) {
+          ++p;
+        }
+        if (p > nameStart) {
+          names.push_back(std::string(
+              reinterpret_cast<const char *>(data + nameStart),
+              p - nameStart));
+        }
+      }
+    }
+    i = lineEnd + 1;
+  }
+}
+
+// every blob starts on a 4 byte boundary so vertices/indices can be used
+// straight from the mapping
+size_t align4(size_t size) { return (size + 3) & ~size_t(3); }
+
+const unsigned char *mapFile(const std::string &path, size_t &size) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  size = st.st_size;
+  return static_cast<const unsigned char *>(data);
+}
+
+void writePadded(FILE *file, const void *data, size_t size) {
+  static const char zeros[4] = {0, 0, 0, 0};
+  if (size > 0) {
+    fwrite(data, size, 1, file);
+  }
+  fwrite(zeros, align4(size) - size, 1, file);
+}
+
+} // namespace
+
+MeshCache::MeshCache(const std::string &sourcePath, unsigned int importFlags)
+    : sourcePath(sourcePath), cachePath(sourcePath + ".meshcache"),
+      importFlags(importFlags), sourceHash(0), mapped(nullptr),
+      mappedSize(0) {}
+
+MeshCache::~MeshCache() { unmap(); }
+
+void MeshCache::unmap() {
+  if (mapped) {
+    munmap(const_cast<unsigned char *>(mapped), mappedSize);
+    mapped = nullptr;
+    mappedSize = 0;
+  }
+}
+
+unsigned long long MeshCache::hashFile(const std::string &path) {
+  // 64 bit FNV-1a over the whole file
+  size_t size = 0;
+  const unsigned char *data = mapFile(path, size);
+  if (!data) {
+    return 0;
+  }
+  uint64_t hash = fnv1a(FNV_OFFSET, data, size);
+  munmap(const_cast<unsigned char *>(data), size);
+  return hash;
+}
+
+unsigned long long MeshCache::hashSource(const std::string &path) {
+  size_t size = 0;
+  const unsigned char *data = mapFile(path, size);
+  if (!data) {
+    return 0;
+  }
+  uint64_t hash = fnv1a(FNV_OFFSET, data, size);
+  std::vector<std::string> libraries;
+  materialLibraries(data, size, libraries);
+  munmap(const_cast<unsigned char *>(data), size);
+  // material colours and texture paths live in the .mtl, the cache bakes
+  // both. a missing library hashes as 0, so adding it invalidates too
+  std::string directory = directoryOf(path);
+  for (const std::string &library : libraries) {
+    uint64_t libraryHash = hashFile(directory + '/' + library);
+    hash = fnv1a(hash, reinterpret_cast<const unsigned char *>(&libraryHash),
+                 sizeof(libraryHash));
+  }
+  return hash;
+}
+
+bool MeshCache::open() {
+  unmap();
+  sourceHash = hashSource(sourcePath);
+  mapped = mapFile(cachePath, mappedSize);
+  if (!mapped) {
+    return false;
+  }
+  const CacheHeader *header = reinterpret_cast<const CacheHeader *>(mapped);
+  if (mappedSize < sizeof(CacheHeader) ||
+      memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 ||
+      header->version != MESH_CACHE_VERSION ||
+      header->vertexSize != sizeof(Vertex) ||
+      header->importFlags != importFlags || header->sourceHash != sourceHash) {
+    std::cout << "mesh cache " << cachePath << " is stale, rebuilding"
+              << std::endl;
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+bool MeshCache::read(std::vector<CachedMesh> &meshes) {
+  if (!mapped) {
+    return false;
+  }
+  const CacheHeader *header = reinterpret_cast<const CacheHeader *>(mapped);
+  size_t offset = sizeof(CacheHeader);
+  const size_t end = mappedSize;
+  auto take = [&](size_t size) -> const unsigned char * {
+    if (offset + size > end) {
+      return nullptr;
+    }
+    const unsigned char *ptr = mapped + offset;
+    offset += align4(size);
+    return ptr;
+  };
+
+  meshes.clear();
+  meshes.reserve(header->meshCount);
+  for (unsigned int i = 0; i < header->meshCount; ++i) {
+    const MeshRecord *record =
+        reinterpret_cast<const MeshRecord *>(take(sizeof(MeshRecord)));
+    if (!record) {
+      break;
+    }
+    CachedMesh mesh;
+    const unsigned char *name = take(record->nameLength);
+    if (!name) {
+      break;
+    }
+    mesh.name.assign(reinterpret_cast<const char *>(name), record->nameLength);
+    mesh.diffuse = glm::vec3(record->diffuse[0], record->diffuse[1],
+                             record->diffuse[2]);
+    mesh.specular = glm::vec3(record->specular[0], record->specular[1],
+                              record->specular[2]);
+    mesh.shininess = record->shininess;
+    mesh.opacity = record->opacity;
+
+    bool valid = true;
+    for (unsigned int k = 0; k < record->textureCount && valid; ++k) {
+      const TextureRecord *texRecord =
+          reinterpret_cast<const TextureRecord *>(take(sizeof(TextureRecord)));
+      const unsigned char *path =
+          texRecord ? take(texRecord->pathLength) : nullptr;
+      if (!path) {
+        valid = false;
+        break;
+      }
+      CachedTexture texture;
+      texture.type = static_cast<Texture::TextureType>(texRecord->type);
+      texture.path.assign(reinterpret_cast<const char *>(path),
+                          texRecord->pathLength);
+      mesh.textures.push_back(texture);
+    }
+
+    mesh.vertexCount = record->vertexCount;
+    mesh.indexCount = record->indexCount;
+    mesh.vertices = reinterpret_cast<const Vertex *>(
+        take(size_t(record->vertexCount) * sizeof(Vertex)));
+    mesh.indices = reinterpret_cast<const unsigned int *>(
+        take(size_t(record->indexCount) * sizeof(unsigned int)));
+    if (!valid || (record->vertexCount && !mesh.vertices) ||
+        (record->indexCount && !mesh.indices)) {
+      break;
+    }
+    meshes.push_back(mesh);
+  }
+
+  if (meshes.size() != header->meshCount) {
+    std::cout << "mesh cache " << cachePath << " is truncated" << std::endl;
+    meshes.clear();
+    return false;
+  }
+  return true;
+}
+
+bool MeshCache::write(const std::vector<Mesh> &meshes,
+                      const std::string &directory) {
+  if (sourceHash == 0) {
+    sourceHash = hashSource(sourcePath);
+  }
+  // write next to the final file and rename, so a crash never leaves a
+  // half written cache behind
+  std::string tmpPath = cachePath + ".tmp";
+  FILE *file = fopen(tmpPath.c_str(), "wb");
+  if (!file) {
+    std::cout << "mesh cache " << tmpPath << " open failed" << std::endl;
+    return false;
+  }
+
+  CacheHeader header;
+  memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+  header.version = MESH_CACHE_VERSION;
+  header.vertexSize = sizeof(Vertex);
+  header.importFlags = importFlags;
+  header.sourceHash = sourceHash;
+  header.meshCount = meshes.size();
+  header.reserved = 0;
+  fwrite(&header, sizeof(header), 1, file);
+
+  std::string canonicalDirectory = FileUtils::canonicalPath(directory) + '/';
+  for (const Mesh &mesh : meshes) {
+    Material material =
+        mesh.materials.empty() ? Material() : mesh.materials[0];
+    MeshRecord record;
+    record.nameLength = mesh.name.size();
+    record.vertexCount = mesh.vertices.size();
+    record.indexCount = mesh.indices.size();
+    record.textureCount = material.textures.size();
+    for (int c = 0; c < 3; ++c) {
+      record.diffuse[c] = material.diffuse[c];
+      record.specular[c] = material.specular[c];
+    }
+    record.shininess = material.shininess;
+    record.opacity = material.opacity;
+    writePadded(file, &record, sizeof(record));
+    writePadded(file, mesh.name.data(), mesh.name.size());
+
+    for (const Texture &texture : material.textures) {
+      // textures are stored relative to the model directory when possible,
+      // a shared texture may have been registered from somewhere else
+      std::string path = FileUtils::canonicalPath(texture.getFileName());
+      if (path.compare(0, canonicalDirectory.size(), canonicalDirectory) ==
+          0) {
+        path = path.substr(canonicalDirectory.size());
+      }
+      TextureRecord texRecord;
+      texRecord.type = static_cast<uint32_t>(texture.getType());
+      texRecord.pathLength = path.size();
+      writePadded(file, &texRecord, sizeof(texRecord));
+      writePadded(file, path.data(), path.size());
+    }
+
+    writePadded(file, mesh.vertices.data(),
+                mesh.vertices.size() * sizeof(Vertex));
+    writePadded(file, mesh.indices.data(),
+                mesh.indices.size() * sizeof(unsigned int));
+  }
+
+  bool ok = !ferror(file);
+  fclose(file);
+  if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+    std::cout << "mesh cache " << cachePath << " write failed" << std::endl;
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,66 @@
+
+#ifndef OPENGL_MESHCACHE_H
+#define OPENGL_MESHCACHE_H
+
+#include "mesh.h"
+#include <glm/vec3.hpp>
+#include <string>
+#include <vector>
+
+// bump whenever the on-disk layout, struct Vertex or the import processing
+// changes
+constexpr unsigned int MESH_CACHE_VERSION = 2;
+
+struct CachedTexture {
+  Texture::TextureType type;
+  // relative to the model directory, absolute if the file lives elsewhere
+  std::string path;
+};
+
+struct CachedMesh {
+  std::string name;
+  // point into the mapped cache file, valid while the MeshCache is alive
+  const Vertex *vertices;
+  unsigned int vertexCount;
+  const unsigned int *indices;
+  unsigned int indexCount;
+  glm::vec3 diffuse;
+  glm::vec3 specular;
+  float shininess;
+  float opacity;
+  std::vector<CachedTexture> textures;
+};
+
+/**
+ * binary geometry cache stored next to the source model (<model>.meshcache).
+ * it is keyed on the hash of the source file and the material libraries it
+ * references plus the assimp import flags, so editing the model, its
+ * materials or changing the post-processing steps invalidates it.
+ */
+class MeshCache {
+public:
+  MeshCache(const std::string &sourcePath, unsigned int importFlags);
+  ~MeshCache();
+  MeshCache(const MeshCache &) = delete;
+  MeshCache &operator=(const MeshCache &) = delete;
+  // map the cache file and validate it against the source
+  bool open();
+  bool read(std::vector<CachedMesh> &meshes);
+  bool write(const std::vector<Mesh> &meshes, const std::string &directory);
+
+  static unsigned long long hashFile(const std::string &path);
+  // hashFile of path folded with that of every OBJ mtllib it names
+  static unsigned long long hashSource(const std::string &path);
+
+private:
+  void unmap();
+
+  std::string sourcePath;
+  std::string cachePath;
+  unsigned int importFlags;
+  unsigned long long sourceHash;
+  const unsigned char *mapped;
+  size_t mappedSize;
+};
+
+#endif // OPENGL_MESHCACHE_H
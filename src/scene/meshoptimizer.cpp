@@ -0,0 +1,327 @@
+
+#include "meshoptimizer.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <unordered_map>
+
+namespace {
+
+const unsigned int INVALID_INDEX = ~0u;
+
+struct VertexHash {
+  size_t operator()(const Vertex &vertex) const {
+    // FNV-1a, Vertex is only floats so there is no padding to skip
+    const unsigned char *bytes =
+        reinterpret_cast<const unsigned char *>(&vertex);
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(Vertex); ++i) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+  }
+};
+
+struct VertexEqual {
+  bool operator()(const Vertex &a, const Vertex &b) const {
+    return memcmp(&a, &b, sizeof(Vertex)) == 0;
+  }
+};
+
+// a FIFO cache simulated with timestamps: a vertex is cached while fewer
+// than cacheSize misses happened since it was loaded
+class CacheSimulator {
+public:
+  CacheSimulator(unsigned int vertexCount, unsigned int cacheSize)
+      : timestamps(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+  unsigned int access(unsigned int vertex) {
+    if (time - timestamps[vertex] > cacheSize) {
+      timestamps[vertex] = time++;
+      return 1;
+    }
+    return 0;
+  }
+  void reset() { time += cacheSize + 1; }
+
+private:
+  std::vector<unsigned int> timestamps;
+  unsigned int time;
+  unsigned int cacheSize;
+};
+
+unsigned int triangleMisses(CacheSimulator &cache,
+                            const unsigned int *triangle) {
+  return cache.access(triangle[0]) + cache.access(triangle[1]) +
+         cache.access(triangle[2]);
+}
+
+struct Cluster {
+  unsigned int begin;
+  unsigned int end;
+  float sortKey;
+};
+
+} // namespace
+
+float VertexCacheStats::acmr() const {
+  return triangles ? float(misses) / float(triangles) : 0.0f;
+}
+
+float VertexCacheStats::atvr() const {
+  return vertices ? float(misses) / float(vertices) : 0.0f;
+}
+
+VertexCacheStats &VertexCacheStats::operator+=(const VertexCacheStats &other) {
+  misses += other.misses;
+  triangles += other.triangles;
+  vertices += other.vertices;
+  return *this;
+}
+
+void MeshOptimizer::optimize(std::vector<Vertex> &vertices,
+                             std::vector<unsigned int> &indices,
+                             float overdrawThreshold) {
+  if (indices.empty() || indices.size() % 3 != 0) {
+    return;
+  }
+  weldVertices(vertices, indices);
+  optimizeVertexCache(indices, vertices.size());
+  optimizeOverdraw(indices, vertices, overdrawThreshold);
+  optimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizer::weldVertices(std::vector<Vertex> &vertices,
+                                 std::vector<unsigned int> &indices) {
+  std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+  unique.reserve(vertices.size());
+  std::vector<unsigned int> remap(vertices.size());
+  std::vector<Vertex> welded;
+  welded.reserve(vertices.size());
+  for (unsigned int i = 0; i < vertices.size(); ++i) {
+    std::pair<std::unordered_map<Vertex, unsigned int, VertexHash,
+                                 VertexEqual>::iterator,
+              bool>
+        inserted = unique.insert(std::make_pair(vertices[i], welded.size()));
+    if (inserted.second) {
+      welded.push_back(vertices[i]);
+    }
+    remap[i] = inserted.first->second;
+  }
+  for (unsigned int &index : indices) {
+    index = remap[index];
+  }
+  vertices.swap(welded);
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): fan around the current vertex and
+// pick the next one among the just emitted vertices still likely cached
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices,
+                                        unsigned int vertexCount) {
+  unsigned int triangleCount = indices.size() / 3;
+  const int cacheSize = VERTEX_CACHE_SIZE;
+
+  // vertex -> triangle adjacency
+  std::vector<unsigned int> liveTriangles(vertexCount, 0);
+  for (unsigned int index : indices) {
+    ++liveTriangles[index];
+  }
+  std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+  for (unsigned int v = 0; v < vertexCount; ++v) {
+    adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+  }
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<unsigned int> fill(adjacencyOffsets.begin(),
+                                 adjacencyOffsets.end() - 1);
+  for (unsigned int t = 0; t < triangleCount; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+  }
+
+  std::vector<int> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<unsigned int> deadEnd;
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+  int timestamp = cacheSize + 1;
+  unsigned int cursor = 0;
+  unsigned int fanning = vertexCount > 0 ? 0 : INVALID_INDEX;
+
+  while (fanning != INVALID_INDEX) {
+    candidates.clear();
+    for (unsigned int a = adjacencyOffsets[fanning];
+         a < adjacencyOffsets[fanning + 1]; ++a) {
+      unsigned int t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        unsigned int v = indices[t * 3 + k];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        --liveTriangles[v];
+        if (timestamp - cacheTime[v] > cacheSize) {
+          cacheTime[v] = timestamp++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // prefer the candidate that stays in the cache the longest while it
+    // still has triangles left
+    unsigned int next = INVALID_INDEX;
+    int best = -1;
+    for (unsigned int v : candidates) {
+      if (liveTriangles[v] == 0) {
+        continue;
+      }
+      int priority = 0;
+      if (timestamp - cacheTime[v] + 2 * int(liveTriangles[v]) <= cacheSize) {
+        priority = timestamp - cacheTime[v];
+      }
+      if (priority > best) {
+        best = priority;
+        next = v;
+      }
+    }
+    // dead end: go back through recently emitted vertices, then scan
+    while (next == INVALID_INDEX && !deadEnd.empty()) {
+      unsigned int v = deadEnd.back();
+      deadEnd.pop_back();
+      if (liveTriangles[v] > 0) {
+        next = v;
+      }
+    }
+    while (next == INVALID_INDEX && cursor < vertexCount) {
+      if (liveTriangles[cursor] > 0) {
+        next = cursor;
+      }
+      ++cursor;
+    }
+    fanning = next;
+  }
+  indices.swap(result);
+}
+
+// clusters of the cache optimized order are sorted so that triangles facing
+// away from the mesh center, which tend to occlude the rest, come first
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices,
+                                     const std::vector<Vertex> &vertices,
+                                     float threshold) {
+  unsigned int triangleCount = indices.size() / 3;
+  if (triangleCount < 2) {
+    return;
+  }
+  CacheSimulator cache(vertices.size(), VERTEX_CACHE_SIZE);
+
+  // hard boundaries where the cache optimized order starts over anyway
+  std::vector<unsigned int> hardBoundaries(1, 0);
+  triangleMisses(cache, &indices[0]);
+  for (unsigned int t = 1; t < triangleCount; ++t) {
+    if (triangleMisses(cache, &indices[t * 3]) == 3) {
+      hardBoundaries.push_back(t);
+    }
+  }
+  hardBoundaries.push_back(triangleCount);
+
+  // split further while each piece keeps its acmr within the threshold
+  std::vector<Cluster> clusters;
+  for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+    unsigned int begin = hardBoundaries[h], end = hardBoundaries[h + 1];
+    cache.reset();
+    unsigned int misses = 0;
+    for (unsigned int t = begin; t < end; ++t) {
+      misses += triangleMisses(cache, &indices[t * 3]);
+    }
+    float clusterThreshold = threshold * float(misses) / float(end - begin);
+
+    cache.reset();
+    unsigned int start = begin, running = 0;
+    for (unsigned int t = begin; t < end; ++t) {
+      running += triangleMisses(cache, &indices[t * 3]);
+      if (t + 1 < end &&
+          float(running) <= float(t + 1 - start) * clusterThreshold) {
+        clusters.push_back(Cluster{start, t + 1, 0.0f});
+        start = t + 1;
+        running = 0;
+        cache.reset();
+      }
+    }
+    clusters.push_back(Cluster{start, end, 0.0f});
+  }
+
+  glm::vec3 meshCenter(0.0f);
+  for (const Vertex &vertex : vertices) {
+    meshCenter += vertex.position;
+  }
+  meshCenter /= float(vertices.size());
+
+  for (Cluster &cluster : clusters) {
+    glm::vec3 center(0.0f), normal(0.0f);
+    float area = 0.0f;
+    for (unsigned int t = cluster.begin; t < cluster.end; ++t) {
+      const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+      const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+      glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+      float triangleArea = glm::length(cross);
+      center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+      normal += cross;
+      area += triangleArea;
+    }
+    float normalLength = glm::length(normal);
+    if (area > 0.0f && normalLength > 0.0f) {
+      cluster.sortKey =
+          glm::dot(center / area - meshCenter, normal / normalLength);
+    }
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.sortKey > b.sortKey;
+                   });
+
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+  for (const Cluster &cluster : clusters) {
+    result.insert(result.end(), indices.begin() + cluster.begin * 3,
+                  indices.begin() + cluster.end * 3);
+  }
+  indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices,
+                                        std::vector<unsigned int> &indices) {
+  std::vector<unsigned int> remap(vertices.size(), INVALID_INDEX);
+  std::vector<Vertex> ordered;
+  ordered.reserve(vertices.size());
+  for (unsigned int &index : indices) {
+    if (remap[index] == INVALID_INDEX) {
+      remap[index] = ordered.size();
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  // vertices no triangle references are dropped
+  vertices.swap(ordered);
+}
+
+VertexCacheStats
+MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int> &indices,
+                                  unsigned int vertexCount,
+                                  unsigned int cacheSize) {
+  VertexCacheStats stats;
+  CacheSimulator cache(vertexCount, cacheSize);
+  std::vector<bool> referenced(vertexCount, false);
+  for (unsigned int index : indices) {
+    stats.misses += cache.access(index);
+    if (!referenced[index]) {
+      referenced[index] = true;
+      ++stats.vertices;
+    }
+  }
+  stats.triangles = indices.size() / 3;
+  return stats;
+}
@@ -0,0 +1,52 @@
+
+#ifndef OPENGL_MESHOPTIMIZER_H
+#define OPENGL_MESHOPTIMIZER_H
+
+#include <vector>
+
+struct Vertex;
+
+constexpr unsigned int VERTEX_CACHE_SIZE = 16;
+
+// FIFO post-transform cache simulation of an index buffer
+struct VertexCacheStats {
+  unsigned long long misses = 0;
+  unsigned long long triangles = 0;
+  unsigned long long vertices = 0;
+  // average cache miss ratio: transformed vertices per triangle
+  float acmr() const;
+  // average transform to vertex ratio: 1.0 is optimal
+  float atvr() const;
+  VertexCacheStats &operator+=(const VertexCacheStats &other);
+};
+
+/**
+ * import time geometry optimization, run on every mesh before it is uploaded
+ * and written to the mesh cache:
+ *  1. weld bitwise identical vertices
+ *  2. reorder triangles for the post-transform cache (Tipsify)
+ *  3. reorder clusters of triangles to reduce overdraw, keeping the cache
+ *     efficiency within overdrawThreshold of step 2
+ *  4. reorder vertices in first use order for fetch locality
+ */
+class MeshOptimizer {
+public:
+  static void optimize(std::vector<Vertex> &vertices,
+                       std::vector<unsigned int> &indices,
+                       float overdrawThreshold = 1.05f);
+  static void weldVertices(std::vector<Vertex> &vertices,
+                           std::vector<unsigned int> &indices);
+  static void optimizeVertexCache(std::vector<unsigned int> &indices,
+                                  unsigned int vertexCount);
+  static void optimizeOverdraw(std::vector<unsigned int> &indices,
+                               const std::vector<Vertex> &vertices,
+                               float threshold);
+  static void optimizeVertexFetch(std::vector<Vertex> &vertices,
+                                  std::vector<unsigned int> &indices);
+  static VertexCacheStats
+  analyzeVertexCache(const std::vector<unsigned int> &indices,
+                     unsigned int vertexCount,
+                     unsigned int cacheSize = VERTEX_CACHE_SIZE);
+};
+
+#endif // OPENGL_MESHOPTIMIZER_H
@@ -1,55 +1,263 @@
 
 #include "model.h"
 #include "../light/light.h"
+#include "../material/textureregistry.h"
 #include "../renderengine/stb_image.h"
+#include "../utils/threadpool.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <mutex>
 
-Model::Model(const std::string &path, Transformation &transformation)
-    : transformation(transformation) {
+const unsigned int IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+// occluders are at least this fraction of the model's diagonal
+const float OCCLUDER_MIN_SIZE = 0.1f;
+const unsigned int OCCLUDER_MAX_TRIANGLES = 4096;
+
+// guards pendingUploads and the uploader queue, meshes are built on worker
+// threads and request their textures concurrently
+static std::mutex pendingUploadsMutex;
+
+Model::Model(const std::string &path, Transformation &transformation,
+             TextureUploader *textureUploader, GeometryResidency residency)
+    : Model(path, std::vector<Transformation>(1, transformation),
+            textureUploader, residency) {}
+
+Model::Model(const std::string &path,
+             const std::vector<Transformation> &instances,
+             TextureUploader *textureUploader, GeometryResidency residency)
+    : instances(instances), path(path), textureUploader(textureUploader),
+      residency(residency) {
   loadModel(path);
+  this->textureUploader = nullptr;
 }
 
 void Model::loadModel(const std::string &path) {
-  Assimp::Importer importer;
-  const aiScene *scene =
-      importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs |
-                                  aiProcess_CalcTangentSpace);
-  // check for errors
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-      !scene->mRootNode) // if is Not Zero
-  {
-    std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-    return;
-  }
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
   // retrieve the directory path of the filepath
   directory = path.substr(0, path.find_last_of('/'));
 
-  // process ASSIMP's root node recursively
-  processNode(scene->mRootNode, scene);
+  // textures are decoded on worker threads while the meshes are processed
+  TextureDecoder decoder;
+  textureDecoder = &decoder;
+
+  // warm start: take vertices/indices straight from the mapped cache
+  MeshCache meshCache(path, IMPORT_FLAGS);
+  bool warm = meshCache.open() && loadFromCache(meshCache);
+
+  if (!warm) {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(path, IMPORT_FLAGS);
+    // check for errors
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) // if is Not Zero
+    {
+      std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString()
+                << std::endl;
+      textureDecoder = nullptr;
+      return;
+    }
+
+    // process ASSIMP's root node recursively, then build the meshes
+    std::vector<aiMesh *> sceneMeshes;
+    processNode(scene->mRootNode, scene, sceneMeshes);
+    processMeshes(sceneMeshes, scene);
+    // the cache stores the optimized geometry, so this only runs cold
+    std::cout << "vertex cache (" << VERTEX_CACHE_SIZE
+              << " entries) ACMR " << importedCacheStats.acmr() << " -> "
+              << optimizedCacheStats.acmr() << ", ATVR "
+              << importedCacheStats.atvr() << " -> "
+              << optimizedCacheStats.atvr() << std::endl;
+    meshCache.write(meshes, directory);
+    selectOccluders();
+  }
+
+  if (!textureUploader) {
+    uploadTextures();
+  }
+  textureDecoder = nullptr;
+  // the cache has been written, the cpu copy is no longer needed for it.
+  // warm meshes already hold exactly this, so it is a no-op for them
+  setResidency(residency);
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "model " << path << " loaded " << (warm ? "warm" : "cold")
+            << " (" << (warm ? "mesh cache" : "assimp") << ") in "
+            << elapsed.count() << " ms" << std::endl;
+  printMemoryReport();
+}
+
+void Model::setResidency(GeometryResidency residency) {
+  this->residency = residency;
+  for (Mesh &mesh : meshes) {
+    mesh.setResidency(residencyOf(mesh));
+  }
+}
+
+GeometryResidency Model::residencyOf(const Mesh &mesh) const {
+  return mesh.occluder && residency == GeometryResidency::RELEASE
+             ? GeometryResidency::POSITIONS
+             : residency;
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene) {
+void Model::selectOccluders() {
+  if (meshes.empty()) {
+    return;
+  }
+  VertexBounds bounds = meshes[0].bounds;
+  for (const Mesh &mesh : meshes) {
+    bounds.min = glm::min(bounds.min, mesh.bounds.min);
+    bounds.max = glm::max(bounds.max, mesh.bounds.max);
+  }
+  // walls, floors and pillars: big next to the model and cheap to raster
+  float minimumSize =
+      OCCLUDER_MIN_SIZE * glm::length(bounds.max - bounds.min);
+  unsigned int occluderNum = 0;
+  for (Mesh &mesh : meshes) {
+    mesh.occluder =
+        mesh.indexCount / 3 <= OCCLUDER_MAX_TRIANGLES &&
+        glm::length(mesh.bounds.max - mesh.bounds.min) >= minimumSize;
+    occluderNum += mesh.occluder;
+  }
+  std::cout << occluderNum << " of " << meshes.size()
+            << " meshes are occluders" << std::endl;
+}
+
+size_t Model::cpuBytes() const {
+  size_t bytes = 0;
+  for (const Mesh &mesh : meshes) {
+    bytes += mesh.cpuBytes();
+  }
+  return bytes;
+}
+
+size_t Model::gpuBytes() const {
+  size_t bytes = 0;
+  for (const Mesh &mesh : meshes) {
+    bytes += mesh.gpuBytes();
+  }
+  return bytes;
+}
+
+void Model::printMemoryReport() const {
+  const char *residencyNames[] = {"release", "keep", "positions"};
+  size_t unpackedBytes = 0;
+  for (const Mesh &mesh : meshes) {
+    unpackedBytes += size_t(mesh.vertexCount) * sizeof(Vertex) +
+                     size_t(mesh.indexCount) * sizeof(unsigned int);
+  }
+  std::cout << "model " << path << " geometry: gpu " << gpuBytes() / 1024
+            << " KB (" << unpackedBytes / 1024 << " KB unpacked), cpu "
+            << cpuBytes() / 1024 << " KB ("
+            << residencyNames[(int)residency] << ")" << std::endl;
+}
+
+bool Model::loadFromCache(MeshCache &meshCache) {
+  std::vector<CachedMesh> cachedMeshes;
+  if (!meshCache.read(cachedMeshes)) {
+    return false;
+  }
+  meshes.reserve(cachedMeshes.size());
+  for (const CachedMesh &cached : cachedMeshes) {
+    Material material = Material();
+    material.diffuse = cached.diffuse;
+    material.specular = cached.specular;
+    material.shininess = cached.shininess;
+    material.opacity = cached.opacity;
+    for (const CachedTexture &cachedTex : cached.textures) {
+      material.textures.push_back(loadTexture(cachedTex.path, cachedTex.type));
+      switch (cachedTex.type) {
+      case Texture::TextureType::DIFFUSE:
+        material.hasDiffuseTex = true;
+        break;
+      case Texture::TextureType::SPECULAR:
+        material.hasSpecularTex = true;
+        break;
+      case Texture::TextureType::NORMAL:
+        material.hasNormalMap = true;
+        break;
+      case Texture::TextureType::HEIGHT:
+        material.hasDepthMap = true;
+        break;
+      }
+    }
+    meshes.emplace_back(cached.name, cached.vertices, cached.vertexCount,
+                        cached.indices, cached.indexCount,
+                        std::vector<Material>{std::move(material)});
+  }
+  // occluders only need the bounds, so they are known before anything is
+  // copied out of the mapping
+  selectOccluders();
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    const CachedMesh &cached = cachedMeshes[i];
+    meshes[i].retain(cached.vertices,
+                     cached.indexCount ? cached.indices : nullptr,
+                     residencyOf(meshes[i]));
+  }
+  return true;
+}
+
+void Model::processNode(aiNode *node, const aiScene *scene,
+                        std::vector<aiMesh *> &sceneMeshes) {
   for (unsigned int i = 0; i < node->mNumMeshes; i++) {
     // the node object only contains indices to index the actual objects in the
     // scene. the scene contains all the data, node is just to keep stuff
     // organized (like relations between nodes).
-    aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-    meshes.push_back(processMesh(mesh, scene));
+    sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
   }
   // after we've processed all of the meshes (if any) we then recursively
   // process each of the children nodes
   for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], scene, sceneMeshes);
   }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
+void Model::processMeshes(const std::vector<aiMesh *> &sceneMeshes,
+                          const aiScene *scene) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<VertexCacheStats> importedStats(sceneMeshes.size());
+  std::vector<VertexCacheStats> optimizedStats(sceneMeshes.size());
+  std::vector<std::future<MeshData>> jobs;
+  jobs.reserve(sceneMeshes.size());
+  ThreadPool pool;
+  for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+    aiMesh *mesh = sceneMeshes[i];
+    VertexCacheStats *imported = &importedStats[i];
+    VertexCacheStats *optimized = &optimizedStats[i];
+    jobs.push_back(pool.submit([this, mesh, scene, imported, optimized]() {
+      return processMesh(mesh, scene, *imported, *optimized);
+    }));
+  }
+
+  // GL objects are created here in node order, however the jobs finish
+  meshes.reserve(meshes.size() + jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    meshes.emplace_back(jobs[i].get());
+    importedCacheStats += importedStats[i];
+    optimizedCacheStats += optimizedStats[i];
+  }
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << jobs.size() << " meshes built on " << pool.size()
+            << " threads in " << elapsed.count() << " ms" << std::endl;
+}
+
+MeshData Model::processMesh(aiMesh *mesh, const aiScene *scene,
+                            VertexCacheStats &importedStats,
+                            VertexCacheStats &optimizedStats) {
   // data to fill
-  std::vector<Vertex> vertices;
-  std::vector<unsigned int> indices;
+  MeshData data;
+  data.name = mesh->mName.C_Str();
+  std::vector<Vertex> &vertices = data.vertices;
+  std::vector<unsigned int> &indices = data.indices;
 
   // Walk through each of the mesh's vertices
   for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -98,6 +306,14 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
       indices.push_back(face.mIndices[j]);
   }
 
+  // weld, cache/overdraw and fetch order before anything is uploaded
+  importedStats = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+  MeshOptimizer::optimize(vertices, indices);
+  optimizedStats = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+  data.bounds = VertexFormat::computeBounds(vertices.data(), vertices.size());
+  data.sphere =
+      BoundingSphere::compute(vertices.data(), vertices.size(), data.bounds);
+
   // process materials
   aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
   Material dstMaterial = Material();
@@ -154,9 +370,9 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
   material->Get(AI_MATKEY_OPACITY, floatParam);
   dstMaterial.opacity = floatParam;
 
-  // return a mesh object created from the extracted mesh data
-  return Mesh(mesh->mName.C_Str(), vertices, indices,
-              std::vector<Material>{dstMaterial});
+  // the GL objects are created from it later, on the context thread
+  data.materials.push_back(std::move(dstMaterial));
+  return data;
 }
 
 // checks all material textures of a given type and loads the textures if
@@ -169,33 +385,53 @@ Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
   for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
     mat->GetTexture(type, i, &str);
-    // check if texture was loaded before and if so, continue to next iteration:
-    // skip loading a new texture
-
-    if (loadedTextures.count(str.C_Str()) <=
-        0) { // if texture hasn't been loaded already, load it
-      std::string filename = directory + '/' + std::string(str.C_Str());
-      Texture texture(GL_TEXTURE_2D, filename, typeName);
-      texture.load();
-      textures.push_back(texture);
-      loadedTextures[str.C_Str()] = texture;
-    } else {
-      textures.push_back(loadedTextures[str.C_Str()]);
-    }
+    textures.push_back(loadTexture(str.C_Str(), typeName));
   }
   return textures;
 }
 
-glm::vec3 Model::transformAIcolor(aiColor3D aiColor3D) {
-  return glm::vec3(aiColor3D.r, aiColor3D.g, aiColor3D.b);
+Texture Model::loadTexture(const std::string &path,
+                           Texture::TextureType typeName) {
+  // absolute paths come from textures shared with other model directories
+  std::string filename = path[0] == '/' ? path : directory + '/' + path;
+  // every call takes a reference for the material, only the first loads it
+  bool created;
+  Texture texture = TextureRegistry::acquire(filename, typeName, created);
+  if (!created) {
+    return texture;
+  }
+  if (textureUploader) {
+    // streamed in by the render loop, materials bind a fallback until then
+    std::lock_guard<std::mutex> lock(pendingUploadsMutex);
+    textureUploader->enqueue(texture);
+  } else if (textureDecoder) {
+    // only queue the decode, the GL object is created in uploadTextures
+    textureDecoder->request(filename);
+    std::lock_guard<std::mutex> lock(pendingUploadsMutex);
+    pendingUploads.push_back(texture);
+  } else {
+    texture.load();
+  }
+  return texture;
 }
 
-void Model::draw(ShaderProgram &shaderProgram, std::vector<Light *> &lights,
-                 bool withMaterials) {
-  glm::mat4 modelTransform = transformation.getTransformationMat();
-  shaderProgram.uniformSetMat4("model", modelTransform);
-
-  for (unsigned int j = 0; j < meshes.size(); ++j) {
-    meshes[j].draw(shaderProgram, withMaterials, lights);
+void Model::uploadTextures() {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (Texture &texture : pendingUploads) {
+    ImageData image = textureDecoder->collect(texture.getFileName());
+    // copies held by the materials share the uploaded GL object
+    texture.upload(image);
   }
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << pendingUploads.size() << " textures decoded on "
+            << textureDecoder->threadNum() << " threads, ready in "
+            << elapsed.count() << " ms" << std::endl;
+  pendingUploads.clear();
+}
+
+glm::vec3 Model::transformAIcolor(aiColor3D aiColor3D) {
+  return glm::vec3(aiColor3D.r, aiColor3D.g, aiColor3D.b);
 }
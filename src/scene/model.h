@@ -4,9 +4,13 @@
 
 #include "../light/light.h"
 #include "../material/material.h"
+#include "../material/texturedecoder.h"
+#include "../material/textureuploader.h"
 #include "../transformation/rotate.h"
 #include "../transformation/transformation.h"
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshoptimizer.h"
 #include <assimp/scene.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -14,26 +18,73 @@
 #include <string>
 #include <vector>
 
+// move-only, the meshes own their GL objects
 class Model {
 public:
   Model() = default;
   ~Model() = default;
-  Model(const std::string &path, Transformation &transformation);
-  void draw(ShaderProgram &shaderProgram, std::vector<Light *> &lights,
-            bool withMaterials = false);
+  Model(const Model &) = delete;
+  Model &operator=(const Model &) = delete;
+  Model(Model &&) = default;
+  Model &operator=(Model &&) = default;
+  // with a textureUploader textures stream in over the next frames instead
+  // of being uploaded before the constructor returns. residency decides how
+  // much of the geometry stays in RAM once it is on the GPU
+  Model(const std::string &path, Transformation &transformation,
+        TextureUploader *textureUploader = nullptr,
+        GeometryResidency residency = GeometryResidency::RELEASE);
+  // the model placed once per transformation, loaded once and drawn
+  // instanced in every pass
+  Model(const std::string &path, const std::vector<Transformation> &instances,
+        TextureUploader *textureUploader = nullptr,
+        GeometryResidency residency = GeometryResidency::RELEASE);
+  // applies to every mesh, single meshes can still be changed afterwards.
+  // occluders keep their positions even with RELEASE
+  void setResidency(GeometryResidency residency);
+  size_t cpuBytes() const;
+  size_t gpuBytes() const;
+  // cpu vs gpu geometry bytes of this model
+  void printMemoryReport() const;
 
   std::vector<Mesh> meshes;
-  Transformation transformation;
-  std::map<std::string, Texture> loadedTextures;
+  // one per placed copy, every mesh is drawn once per instance
+  std::vector<Transformation> instances;
   std::string directory;
+  std::string path;
 
 private:
   void loadModel(const std::string &path);
-  void processNode(aiNode *node, const aiScene *scene);
-  Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+  // uploads from the mapped cache, copies only what residency keeps
+  bool loadFromCache(MeshCache &meshCache);
+  // collects the meshes in node order
+  void processNode(aiNode *node, const aiScene *scene,
+                   std::vector<aiMesh *> &sceneMeshes);
+  // builds the meshes on a thread pool, then uploads them in order
+  void processMeshes(const std::vector<aiMesh *> &sceneMeshes,
+                     const aiScene *scene);
+  // cpu only, runs on worker threads
+  MeshData processMesh(aiMesh *mesh, const aiScene *scene,
+                       VertexCacheStats &importedStats,
+                       VertexCacheStats &optimizedStats);
   std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
                                             Texture::TextureType typeName);
+  Texture loadTexture(const std::string &path, Texture::TextureType typeName);
+  void uploadTextures();
+  // flags the large meshes with few triangles as occluders
+  void selectOccluders();
+  // what mesh keeps under the model residency, see setResidency
+  GeometryResidency residencyOf(const Mesh &mesh) const;
   glm::vec3 transformAIcolor(aiColor3D aiColor3D);
+
+  // textures this model created, waiting for uploadTextures
+  std::vector<Texture> pendingUploads;
+  // only set while loadModel runs
+  TextureDecoder *textureDecoder = nullptr;
+  TextureUploader *textureUploader = nullptr;
+  GeometryResidency residency = GeometryResidency::RELEASE;
+  // vertex cache efficiency as imported vs after MeshOptimizer
+  VertexCacheStats importedCacheStats;
+  VertexCacheStats optimizedCacheStats;
 };
 
 #endif // OPENGL_MODEL_H
@@ -0,0 +1,425 @@
+
+#include "occlusionculler.h"
+#include "model.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+namespace {
+// culled ids are tested on the calling thread below this
+const size_t MIN_PARALLEL_TESTS = 256;
+// w of points this close to the eye counts as crossing the near plane
+const float MIN_W = 1e-5f;
+// in pixels, covers the rounding between two triangles sharing an edge
+const float EDGE_TOLERANCE = 1e-3f;
+const int TILE_SIZE = OcclusionCuller::TILE;
+const int ROW_PITCH = OcclusionCuller::WIDTH;
+
+// clip space polygon of up to 4 vertices after the near plane
+int clipNear(const glm::vec4 *triangle, glm::vec4 *polygon) {
+  int count = 0;
+  for (int i = 0; i < 3; ++i) {
+    const glm::vec4 &from = triangle[i];
+    const glm::vec4 &to = triangle[(i + 1) % 3];
+    float fromDistance = from.z + from.w, toDistance = to.z + to.w;
+    if (fromDistance >= 0.0f) {
+      polygon[count++] = from;
+    }
+    if ((fromDistance >= 0.0f) != (toDistance >= 0.0f)) {
+      float t = fromDistance / (fromDistance - toDistance);
+      polygon[count++] = from + (to - from) * t;
+    }
+  }
+  return count;
+}
+
+glm::vec3 toScreen(const glm::vec4 &clip) {
+  float inverseW = 1.0f / std::max(clip.w, MIN_W);
+  return glm::vec3(
+      (clip.x * inverseW * 0.5f + 0.5f) * OcclusionCuller::WIDTH,
+      (clip.y * inverseW * 0.5f + 0.5f) * OcclusionCuller::HEIGHT,
+      clip.z * inverseW * 0.5f + 0.5f);
+}
+
+// all three outside the same side plane
+bool outsideSide(const glm::vec4 *triangle) {
+  for (int axis = 0; axis < 2; ++axis) {
+    if (triangle[0][axis] > triangle[0].w &&
+        triangle[1][axis] > triangle[1].w &&
+        triangle[2][axis] > triangle[2].w) {
+      return true;
+    }
+    if (triangle[0][axis] < -triangle[0].w &&
+        triangle[1][axis] < -triangle[1].w &&
+        triangle[2][axis] < -triangle[2].w) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// one row of a triangle, pixels [minX, maxX], edges and z start at minX
+void rasterizeRow(float *row, int minX, int maxX, const float *rowStart,
+                  const float *stepX, const float *threshold, float zStart,
+                  float zStepX) {
+  float edges[3] = {rowStart[0], rowStart[1], rowStart[2]};
+  float z = zStart;
+  for (int x = minX; x <= maxX; ++x) {
+    if (edges[0] >= threshold[0] && edges[1] >= threshold[1] &&
+        edges[2] >= threshold[2]) {
+      row[x] = std::min(row[x], z);
+    }
+    for (int e = 0; e < 3; ++e) {
+      edges[e] += stepX[e];
+    }
+    z += zStepX;
+  }
+}
+
+// farthest depth of the TILE x TILE pixels from corner
+float farthest(const float *corner) {
+  float tile = 0.0f;
+  for (int y = 0; y < TILE_SIZE; ++y) {
+    for (int x = 0; x < TILE_SIZE; ++x) {
+      tile = std::max(tile, corner[y * ROW_PITCH + x]);
+    }
+  }
+  return tile;
+}
+
+#ifdef OCCLUSION_SSE
+// rasterizeRow 4 pixels at a time, minX is a multiple of 4
+void rasterizeRowSse(float *row, int minX, int maxX, const float *rowStart,
+                     const float *stepX, const float *threshold,
+                     float zStart, float zStepX) {
+  const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  __m128 edges[3], edgeSteps[3], thresholds[3];
+  for (int e = 0; e < 3; ++e) {
+    thresholds[e] = _mm_set1_ps(threshold[e]);
+    edges[e] = _mm_add_ps(_mm_set1_ps(rowStart[e]),
+                          _mm_mul_ps(lanes, _mm_set1_ps(stepX[e])));
+    edgeSteps[e] = _mm_set1_ps(4.0f * stepX[e]);
+  }
+  __m128 z = _mm_add_ps(_mm_set1_ps(zStart),
+                        _mm_mul_ps(lanes, _mm_set1_ps(zStepX)));
+  __m128 zStep = _mm_set1_ps(4.0f * zStepX);
+  for (int x = minX; x <= maxX; x += 4) {
+    __m128 inside = _mm_and_ps(
+        _mm_and_ps(_mm_cmpge_ps(edges[0], thresholds[0]),
+                   _mm_cmpge_ps(edges[1], thresholds[1])),
+        _mm_cmpge_ps(edges[2], thresholds[2]));
+    if (_mm_movemask_ps(inside)) {
+      __m128 old = _mm_loadu_ps(row + x);
+      __m128 nearer = _mm_min_ps(old, z);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer),
+                                       _mm_andnot_ps(inside, old)));
+    }
+    for (int e = 0; e < 3; ++e) {
+      edges[e] = _mm_add_ps(edges[e], edgeSteps[e]);
+    }
+    z = _mm_add_ps(z, zStep);
+  }
+}
+
+float farthestSse(const float *corner) {
+  __m128 farthest = _mm_setzero_ps();
+  for (int y = 0; y < TILE_SIZE; ++y) {
+    for (int x = 0; x < TILE_SIZE; x += 4) {
+      farthest =
+          _mm_max_ps(farthest, _mm_loadu_ps(corner + y * ROW_PITCH + x));
+    }
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, farthest);
+  return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+#endif
+} // namespace
+
+OcclusionCuller::OcclusionCuller()
+    : depth(WIDTH * HEIGHT, 1.0f),
+      tiles((WIDTH / TILE) * (HEIGHT / TILE), 1.0f) {}
+
+ThreadPool &OcclusionCuller::workers() {
+  if (!pool) {
+    pool.reset(new ThreadPool());
+  }
+  return *pool;
+}
+
+void OcclusionCuller::render(const SceneBVH &bvh,
+                             const std::vector<Model> &models,
+                             const std::vector<uint32_t> &ids,
+                             const glm::mat4 &viewProjection) {
+  this->viewProjection = viewProjection;
+  occluders.clear();
+  for (uint32_t id : ids) {
+    const BVHItem &item = bvh.item(id);
+    if (models[item.model].meshes[item.mesh].occluder) {
+      occluders.push_back(id);
+    }
+  }
+
+  // setup: project the occluders, split evenly over the workers
+  ThreadPool &threads = workers();
+  size_t jobNum = std::min<size_t>(threads.size(), occluders.size());
+  triangles.resize(std::max<size_t>(jobNum, 1));
+  triangles[0].clear();
+  std::vector<std::future<void>> jobs;
+  for (size_t job = 0; job < jobNum; ++job) {
+    size_t first = occluders.size() * job / jobNum;
+    size_t last = occluders.size() * (job + 1) / jobNum;
+    std::vector<ScreenTriangle> *output = &triangles[job];
+    jobs.push_back(threads.submit([this, &bvh, &models, first, last,
+                                   output]() {
+      setUpTriangles(bvh, models, first, last, *output);
+    }));
+  }
+  for (std::future<void> &job : jobs) {
+    job.get();
+  }
+
+  // raster: bands of whole tile rows
+  jobs.clear();
+  int tileRows = HEIGHT / TILE;
+  int bandNum = std::min<int>(threads.size(), tileRows);
+  for (int band = 0; band < bandNum; ++band) {
+    int firstRow = tileRows * band / bandNum * TILE;
+    int lastRow = tileRows * (band + 1) / bandNum * TILE;
+    jobs.push_back(threads.submit(
+        [this, firstRow, lastRow]() { rasterize(firstRow, lastRow); }));
+  }
+  for (std::future<void> &job : jobs) {
+    job.get();
+  }
+}
+
+void OcclusionCuller::setUpTriangles(
+    const SceneBVH &bvh, const std::vector<Model> &models, size_t first,
+    size_t last, std::vector<ScreenTriangle> &output) const {
+  output.clear();
+  std::vector<glm::vec4> clip;
+  for (size_t i = first; i < last; ++i) {
+    const BVHItem &item = bvh.item(occluders[i]);
+    const Mesh &mesh = models[item.model].meshes[item.mesh];
+    glm::mat4 transform = viewProjection * bvh.transform(item.instance);
+    // POSITIONS residency keeps positions, KEEP the whole vertices
+    bool fromPositions = !mesh.positions.empty();
+    size_t vertexNum =
+        fromPositions ? mesh.positions.size() : mesh.vertices.size();
+    clip.resize(vertexNum);
+    for (size_t v = 0; v < vertexNum; ++v) {
+      const glm::vec3 &position =
+          fromPositions ? mesh.positions[v] : mesh.vertices[v].position;
+      clip[v] = transform * glm::vec4(position, 1.0f);
+    }
+
+    size_t indexNum = mesh.indices.empty() ? vertexNum : mesh.indices.size();
+    for (size_t index = 0; index + 2 < indexNum; index += 3) {
+      glm::vec4 triangle[3];
+      for (int corner = 0; corner < 3; ++corner) {
+        triangle[corner] = clip[mesh.indices.empty()
+                                    ? index + corner
+                                    : mesh.indices[index + corner]];
+      }
+      if (outsideSide(triangle)) {
+        continue;
+      }
+      glm::vec4 polygon[4];
+      int count = clipNear(triangle, polygon);
+      for (int fan = 1; fan + 1 < count; ++fan) {
+        output.push_back(ScreenTriangle{{toScreen(polygon[0]),
+                                         toScreen(polygon[fan]),
+                                         toScreen(polygon[fan + 1])}});
+      }
+    }
+  }
+}
+
+void OcclusionCuller::rasterize(int firstRow, int lastRow) {
+  std::fill(depth.begin() + firstRow * WIDTH, depth.begin() + lastRow * WIDTH,
+            1.0f);
+  for (const std::vector<ScreenTriangle> &list : triangles) {
+    for (const ScreenTriangle &triangle : list) {
+      glm::vec3 a = triangle.vertices[0], b = triangle.vertices[1],
+                c = triangle.vertices[2];
+      float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+      if (std::abs(area) < 1e-8f) {
+        continue;
+      }
+      // counter-clockwise, the edge functions are then positive inside
+      if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+      }
+      int minX = std::max(0, int(std::floor(std::min({a.x, b.x, c.x}))));
+      int maxX =
+          std::min(WIDTH - 1, int(std::ceil(std::max({a.x, b.x, c.x}))));
+      int minY =
+          std::max(firstRow, int(std::floor(std::min({a.y, b.y, c.y}))));
+      int maxY =
+          std::min(lastRow - 1, int(std::ceil(std::max({a.y, b.y, c.y}))));
+      if (minX > maxX || minY > maxY) {
+        continue;
+      }
+      // whole groups of 4, WIDTH is a multiple of 4
+      minX &= ~3;
+
+      // edge p -> q: (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x),
+      // each one weighs the vertex opposite to it
+      const glm::vec3 *from[3] = {&b, &c, &a};
+      const glm::vec3 *to[3] = {&c, &a, &b};
+      float stepX[3], stepY[3], rowStart[3], threshold[3];
+      float px = minX + 0.5f, py = minY + 0.5f;
+      for (int e = 0; e < 3; ++e) {
+        stepX[e] = -(to[e]->y - from[e]->y);
+        stepY[e] = to[e]->x - from[e]->x;
+        // the edge function is the distance scaled by the edge length
+        threshold[e] = -EDGE_TOLERANCE * std::sqrt(stepX[e] * stepX[e] +
+                                                   stepY[e] * stepY[e]);
+        rowStart[e] =
+            stepY[e] * (py - from[e]->y) + stepX[e] * (px - from[e]->x);
+      }
+      float zStepX = (stepX[0] * a.z + stepX[1] * b.z + stepX[2] * c.z) / area;
+      float zStepY = (stepY[0] * a.z + stepY[1] * b.z + stepY[2] * c.z) / area;
+      float zRowStart =
+          (rowStart[0] * a.z + rowStart[1] * b.z + rowStart[2] * c.z) / area;
+
+      for (int y = minY; y <= maxY; ++y) {
+        float *row = &depth[y * WIDTH];
+#ifdef OCCLUSION_SSE
+        if (simd) {
+          rasterizeRowSse(row, minX, maxX, rowStart, stepX, threshold,
+                          zRowStart, zStepX);
+        } else {
+          rasterizeRow(row, minX, maxX, rowStart, stepX, threshold,
+                       zRowStart, zStepX);
+        }
+#else
+        rasterizeRow(row, minX, maxX, rowStart, stepX, threshold, zRowStart,
+                     zStepX);
+#endif
+        for (int e = 0; e < 3; ++e) {
+          rowStart[e] += stepY[e];
+        }
+        zRowStart += zStepY;
+      }
+    }
+  }
+
+  // farthest depth of each tile in the band
+  const int tileColumns = WIDTH / TILE;
+  for (int tileY = firstRow / TILE; tileY < lastRow / TILE; ++tileY) {
+    for (int tileX = 0; tileX < tileColumns; ++tileX) {
+      const float *corner = &depth[tileY * TILE * WIDTH + tileX * TILE];
+#ifdef OCCLUSION_SSE
+      tiles[tileY * tileColumns + tileX] =
+          simd ? farthestSse(corner) : farthest(corner);
+#else
+      tiles[tileY * tileColumns + tileX] = farthest(corner);
+#endif
+    }
+  }
+}
+
+void OcclusionCuller::cull(const SceneBVH &bvh, std::vector<uint32_t> &ids) {
+  visible.resize(ids.size());
+  if (ids.size() < MIN_PARALLEL_TESTS) {
+    for (size_t i = 0; i < ids.size(); ++i) {
+      visible[i] = isVisible(bvh.box(ids[i]));
+    }
+  } else {
+    ThreadPool &threads = workers();
+    std::vector<std::future<void>> jobs;
+    for (size_t job = 0; job < threads.size(); ++job) {
+      size_t first = ids.size() * job / threads.size();
+      size_t last = ids.size() * (job + 1) / threads.size();
+      jobs.push_back(threads.submit([this, &bvh, &ids, first, last]() {
+        for (size_t i = first; i < last; ++i) {
+          visible[i] = isVisible(bvh.box(ids[i]));
+        }
+      }));
+    }
+    for (std::future<void> &job : jobs) {
+      job.get();
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (visible[i]) {
+      ids[kept++] = ids[i];
+    }
+  }
+  tested += ids.size();
+  occluded += ids.size() - kept;
+  ids.resize(kept);
+}
+
+bool OcclusionCuller::isVisible(const VertexBounds &box) const {
+  glm::vec2 minimum(FLT_MAX), maximum(-FLT_MAX);
+  float nearest = FLT_MAX;
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::vec4 clip = viewProjection *
+                     glm::vec4(corner & 1 ? box.max.x : box.min.x,
+                               corner & 2 ? box.max.y : box.min.y,
+                               corner & 4 ? box.max.z : box.min.z, 1.0f);
+    // the box reaches the near plane, the depth buffer cannot hide it
+    if (clip.w < MIN_W || clip.z < -clip.w) {
+      return true;
+    }
+    glm::vec3 screen = toScreen(clip);
+    minimum = glm::min(minimum, glm::vec2(screen));
+    maximum = glm::max(maximum, glm::vec2(screen));
+    nearest = std::min(nearest, screen.z);
+  }
+  int minX = std::max(0, int(std::floor(minimum.x)));
+  int maxX = std::min(WIDTH - 1, int(std::ceil(maximum.x)));
+  int minY = std::max(0, int(std::floor(minimum.y)));
+  int maxY = std::min(HEIGHT - 1, int(std::ceil(maximum.y)));
+  if (minX > maxX || minY > maxY) {
+    // passed the frustum test but covers no pixel, keep it
+    return true;
+  }
+
+  // coarse: tiles whose farthest depth is nearer hide their part, the
+  // others fall back to their pixels
+  const int tileColumns = WIDTH / TILE;
+  for (int tileY = minY / TILE; tileY <= maxY / TILE; ++tileY) {
+    for (int tileX = minX / TILE; tileX <= maxX / TILE; ++tileX) {
+      if (nearest > tiles[tileY * tileColumns + tileX]) {
+        continue;
+      }
+      int lastY = std::min(maxY, tileY * TILE + TILE - 1);
+      int lastX = std::min(maxX, tileX * TILE + TILE - 1);
+      for (int y = std::max(minY, tileY * TILE); y <= lastY; ++y) {
+        for (int x = std::max(minX, tileX * TILE); x <= lastX; ++x) {
+          if (nearest <= depth[y * WIDTH + x]) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void OcclusionCuller::setSimd(bool enabled) { simd = enabled; }
+
+float OcclusionCuller::depthAt(int x, int y) const {
+  return depth[y * WIDTH + x];
+}
+
+unsigned int OcclusionCuller::testedCount() const { return tested; }
+
+unsigned int OcclusionCuller::occludedCount() const { return occluded; }
+
+float OcclusionCuller::occludedPercent() const {
+  return tested == 0 ? 0.0f : 100.0f * occluded / tested;
+}
+
+void OcclusionCuller::resetStats() { tested = occluded = 0; }
@@ -0,0 +1,80 @@
+
+#ifndef OPENGL_OCCLUSIONCULLER_H
+#define OPENGL_OCCLUSIONCULLER_H
+
+#include "../utils/threadpool.h"
+#include "scenebvh.h"
+#include <glm/mat4x4.hpp>
+#include <memory>
+#include <vector>
+
+class Model;
+
+/**
+ * software occlusion culling, cpu only. the triangles of the visible
+ * occluder meshes (Mesh::occluder) are rasterized into a small depth
+ * buffer, 4 pixels per SSE step with a scalar fallback, in horizontal
+ * bands on a thread pool. each band then reduces its 8x8 tiles to their
+ * farthest depth. a mesh instance is occluded when the nearest corner of
+ * its box is behind every tile, and failing that every pixel, its screen
+ * rectangle covers. a pixel takes an occluder's depth when its center is
+ * inside the triangle, or within EDGE_TOLERANCE pixels of an edge so that
+ * float error leaves no cracks along shared edges.
+ */
+class OcclusionCuller {
+public:
+  static const int WIDTH = 256;
+  static const int HEIGHT = 128;
+  static const int TILE = 8;
+
+  OcclusionCuller();
+
+  // clears the depth buffer and rasterizes the occluders among ids
+  void render(const SceneBVH &bvh, const std::vector<Model> &models,
+              const std::vector<uint32_t> &ids,
+              const glm::mat4 &viewProjection);
+  // drops the ids hidden behind the last render()
+  void cull(const SceneBVH &bvh, std::vector<uint32_t> &ids);
+  // depth in [0, 1] of pixel x, y, row 0 at the bottom
+  float depthAt(int x, int y) const;
+  // false rasterizes with the scalar loops even where SSE is available, so
+  // the two can be compared. no effect without SSE
+  void setSimd(bool enabled);
+
+  // since the last resetStats
+  unsigned int testedCount() const;
+  unsigned int occludedCount() const;
+  float occludedPercent() const;
+  void resetStats();
+
+private:
+  // screen space, x and y in pixels, z in [0, 1]
+  struct ScreenTriangle {
+    glm::vec3 vertices[3];
+  };
+
+  ThreadPool &workers();
+  // projects and near clips the triangles of occluders [first, last)
+  void setUpTriangles(const SceneBVH &bvh, const std::vector<Model> &models,
+                      size_t first, size_t last,
+                      std::vector<ScreenTriangle> &triangles) const;
+  // rasterizes every triangle into rows [firstRow, lastRow), then builds
+  // the tiles of those rows
+  void rasterize(int firstRow, int lastRow);
+  bool isVisible(const VertexBounds &box) const;
+
+  std::unique_ptr<ThreadPool> pool;
+  glm::mat4 viewProjection;
+  std::vector<float> depth;
+  // farthest depth per tile
+  std::vector<float> tiles;
+  std::vector<uint32_t> occluders;
+  // one list per setup job
+  std::vector<std::vector<ScreenTriangle>> triangles;
+  std::vector<unsigned char> visible;
+  bool simd = true;
+  unsigned int tested = 0;
+  unsigned int occluded = 0;
+};
+
+#endif // OPENGL_OCCLUSIONCULLER_H
@@ -1,36 +1,42 @@
 
 #include "scene.h"
 #include "model.h"
+#include "../material/materialtable.h"
+#include "../material/textureregistry.h"
+#include "../renderengine/geometrybuffer.h"
+#include "../renderengine/glstate.h"
 #include <iostream>
-#include <map>
-Scene::Scene(std::vector<Model> &models, Camera *camera,
+Scene::Scene(std::vector<Model> &&models, Camera *camera,
              std::vector<Light *> &lights, SkyBox *skyBox)
-    : models(models), camera(camera), lights(lights), skyBox(skyBox) {}
+    : models(std::move(models)), camera(camera), lights(lights),
+      skyBox(skyBox) {
+  bvh.build(this->models);
+}
 
 void Scene::cleanUp() {
   for (unsigned int i = 0; i < models.size(); ++i) {
-    std::map<std::string, Texture> maps = models[i].loadedTextures;
-    for (std::map<std::string, Texture>::iterator it = maps.begin();
-         it != maps.end(); ++it) {
-      it->second.cleanUp();
-    }
     for (Mesh &mesh : models[i].meshes) {
       mesh.cleanUp();
     }
-    gBuffer.cleanUp();
   }
+  // shared textures are deleted once, whichever models referenced them
+  TextureRegistry::cleanUp();
+  MaterialTable::cleanUp();
+  GeometryBuffer::cleanUp();
+  lightBuffer.cleanUp();
+  gBuffer.cleanUp();
 }
 
 void Scene::generateFBO(int scrWidth, int scrHeight) {
   // FBO
   glGenFramebuffers(1, &deferredFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, deferredFBO);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, deferredFBO);
 
   // floating point color buffer
   deferredTex = std::vector<GLuint>(2, 0);
   glGenTextures(2, &deferredTex[0]);
   for (unsigned int i = 0; i < 2; ++i) {
-    glBindTexture(GL_TEXTURE_2D, deferredTex[i]);
+    GLState::bindTexture(GL_TEXTURE_2D, deferredTex[i]);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scrWidth, scrHeight, 0, GL_RGBA,
                  GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -54,8 +60,8 @@ void Scene::generateFBO(int scrWidth, int scrHeight) {
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     std::cout << "scene deferred render fbo not complete!" << std::endl;
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
@@ -63,8 +69,8 @@ void Scene::generateBlurFBO(int scrWidth, int scrHeight) {
   glGenFramebuffers(2, pingpongFBO);
   glGenTextures(2, pingpongColorBuffers);
   for (int i = 0; i < 2; ++i) {
-    glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-    glBindTexture(GL_TEXTURE_2D, pingpongColorBuffers[i]);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+    GLState::bindTexture(GL_TEXTURE_2D, pingpongColorBuffers[i]);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, scrWidth, scrHeight, 0, GL_RGB,
                  GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -77,6 +83,6 @@ void Scene::generateBlurFBO(int scrWidth, int scrHeight) {
       std::cout << "scene blur render fbo not complete!" << std::endl;
     }
   }
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
 }
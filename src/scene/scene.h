@@ -4,23 +4,34 @@
 
 #include "../camera/camera.h"
 #include "../light/light.h"
+#include "../light/lightbuffer.h"
 #include "../renderengine/gbuffer.h"
 #include "model.h"
+#include "scenebvh.h"
 #include "skybox.h"
 #include <glad/glad.h>
+// move-only, takes ownership of the models
 class Scene {
 public:
   Scene() = default;
   ~Scene() = default;
-  Scene(std::vector<Model> &models, Camera *camera,
+  Scene(const Scene &) = delete;
+  Scene &operator=(const Scene &) = delete;
+  Scene(Scene &&) = default;
+  Scene &operator=(Scene &&) = default;
+  Scene(std::vector<Model> &&models, Camera *camera,
         std::vector<Light *> &lights, SkyBox *skyBox);
   void cleanUp();
   void generateFBO(int scrWidth, int scrHeight);
   void generateBlurFBO(int scrWidth, int scrHeight);
 
   std::vector<Model> models;
+  // over every mesh instance of models, refit() it after moving instances
+  SceneBVH bvh;
   Camera *camera;
   std::vector<Light *> lights;
+  // lights as the shaders read them, refreshed every lighting pass
+  LightBuffer lightBuffer;
   SkyBox *skyBox;
   GBuffer gBuffer;
   GLuint deferredFBO;
@@ -0,0 +1,446 @@
+
+#include "scenebvh.h"
+#include "model.h"
+#include <algorithm>
+#include <cfloat>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace {
+const int BIN_NUM = 12;
+// a leaf with more items is split even when SAH prefers a leaf
+const uint32_t MAX_LEAF_SIZE = 4;
+// bounds the traversal stacks below
+const int MAX_DEPTH = 48;
+const int STACK_SIZE = MAX_DEPTH + 2;
+// cost of visiting a node relative to testing one item
+const float TRAVERSAL_COST = 1.0f;
+
+VertexBounds emptyBounds() {
+  VertexBounds bounds;
+  bounds.min = glm::vec3(FLT_MAX);
+  bounds.max = glm::vec3(-FLT_MAX);
+  return bounds;
+}
+
+void grow(VertexBounds &bounds, const VertexBounds &other) {
+  bounds.min = glm::min(bounds.min, other.min);
+  bounds.max = glm::max(bounds.max, other.max);
+}
+
+float surfaceArea(const VertexBounds &bounds) {
+  glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(0.0f));
+  return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                 extent.z * extent.x);
+}
+
+glm::vec3 centroid(const VertexBounds &bounds) {
+  return (bounds.min + bounds.max) * 0.5f;
+}
+
+// slab test, the entry distance when the ray enters before maxDistance
+bool intersectBox(const glm::vec3 &min, const glm::vec3 &max,
+                  const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                  float maxDistance, float &entry) {
+  glm::vec3 t0 = (min - origin) * inverseDirection;
+  glm::vec3 t1 = (max - origin) * inverseDirection;
+  glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+  entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+  float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+  return entry <= exit;
+}
+} // namespace
+
+void SceneBVH::build(std::vector<Model> &models) {
+  items.clear();
+  modelFirstMesh.assign(1, 0);
+  meshFirstItem.clear();
+  modelFirstInstance.assign(1, 0);
+  transforms.clear();
+  normalMatrices.clear();
+  versions.clear();
+  for (uint32_t m = 0; m < models.size(); ++m) {
+    Model &model = models[m];
+    uint32_t firstInstance = transforms.size();
+    for (Transformation &instance : model.instances) {
+      transforms.push_back(instance.getWorldMatrix());
+      normalMatrices.push_back(instance.getNormalMatrix());
+      versions.push_back(instance.getVersion());
+    }
+    for (uint32_t k = 0; k < model.meshes.size(); ++k) {
+      meshFirstItem.push_back(items.size());
+      for (uint32_t t = 0; t < model.instances.size(); ++t) {
+        items.push_back(BVHItem{m, k, firstInstance + t});
+      }
+    }
+    modelFirstMesh.push_back(meshFirstItem.size());
+    modelFirstInstance.push_back(transforms.size());
+  }
+
+  boxes.resize(items.size());
+  spheres.resize(items.size());
+  order.resize(items.size());
+  for (uint32_t id = 0; id < items.size(); ++id) {
+    updateItem(id, models[items[id].model]);
+    order[id] = id;
+  }
+  ++version;
+
+  nodes.clear();
+  parents.clear();
+  leafOf.resize(items.size());
+  if (items.empty()) {
+    return;
+  }
+  nodes.reserve(2 * items.size());
+  parents.reserve(2 * items.size());
+  nodes.push_back(BVHNode());
+  parents.push_back(0);
+  split(0, 0, items.size());
+}
+
+void SceneBVH::updateItem(uint32_t id, const Model &model) {
+  const BVHItem &item = items[id];
+  const Mesh &mesh = model.meshes[item.mesh];
+  boxes[id] = mesh.bounds.transformed(transforms[item.instance]);
+  spheres[id] = mesh.sphere.transformed(transforms[item.instance]);
+}
+
+void SceneBVH::split(uint32_t node, uint32_t first, uint32_t count) {
+  VertexBounds bounds = emptyBounds(), centroids = emptyBounds();
+  for (uint32_t i = first; i < first + count; ++i) {
+    grow(bounds, boxes[order[i]]);
+    glm::vec3 center = centroid(boxes[order[i]]);
+    centroids.min = glm::min(centroids.min, center);
+    centroids.max = glm::max(centroids.max, center);
+  }
+  nodes[node].min = bounds.min;
+  nodes[node].max = bounds.max;
+
+  int depth = 0;
+  for (uint32_t n = node; n != 0; n = parents[n]) {
+    ++depth;
+  }
+  // binned SAH over all three axes
+  float leafCost = float(count);
+  float bestCost = FLT_MAX;
+  int bestAxis = -1, bestBin = 0;
+  glm::vec3 extent = centroids.max - centroids.min;
+  for (int axis = 0; axis < 3 && count > 1 && depth < MAX_DEPTH; ++axis) {
+    if (extent[axis] <= 0.0f) {
+      continue;
+    }
+    VertexBounds binBounds[BIN_NUM];
+    uint32_t binCounts[BIN_NUM] = {0};
+    std::fill(binBounds, binBounds + BIN_NUM, emptyBounds());
+    float binScale = BIN_NUM / extent[axis];
+    for (uint32_t i = first; i < first + count; ++i) {
+      float center = centroid(boxes[order[i]])[axis];
+      int bin = std::min(BIN_NUM - 1,
+                         int((center - centroids.min[axis]) * binScale));
+      ++binCounts[bin];
+      grow(binBounds[bin], boxes[order[i]]);
+    }
+    // sweep from the right, then evaluate each plane from the left
+    float rightAreas[BIN_NUM];
+    uint32_t rightCounts[BIN_NUM];
+    VertexBounds right = emptyBounds();
+    uint32_t rightCount = 0;
+    for (int bin = BIN_NUM - 1; bin > 0; --bin) {
+      grow(right, binBounds[bin]);
+      rightCount += binCounts[bin];
+      rightAreas[bin] = surfaceArea(right);
+      rightCounts[bin] = rightCount;
+    }
+    VertexBounds left = emptyBounds();
+    uint32_t leftCount = 0;
+    for (int bin = 1; bin < BIN_NUM; ++bin) {
+      grow(left, binBounds[bin - 1]);
+      leftCount += binCounts[bin - 1];
+      if (leftCount == 0 || rightCounts[bin] == 0) {
+        continue;
+      }
+      float cost = surfaceArea(left) * leftCount +
+                   rightAreas[bin] * rightCounts[bin];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin = bin;
+      }
+    }
+  }
+  float area = surfaceArea(bounds);
+  if (bestAxis >= 0 && area > 0.0f) {
+    bestCost = TRAVERSAL_COST + bestCost / area;
+  }
+
+  uint32_t leftCount = 0;
+  if (bestAxis >= 0 && (bestCost < leafCost || count > MAX_LEAF_SIZE)) {
+    float binScale = BIN_NUM / extent[bestAxis];
+    float minimum = centroids.min[bestAxis];
+    uint32_t *middle = std::partition(
+        &order[first], &order[first] + count, [&](uint32_t id) {
+          float center = centroid(boxes[id])[bestAxis];
+          return std::min(BIN_NUM - 1, int((center - minimum) * binScale)) <
+                 bestBin;
+        });
+    leftCount = middle - &order[first];
+  } else if (count > MAX_LEAF_SIZE && depth < MAX_DEPTH) {
+    // every centroid in one spot, SAH cannot tell them apart
+    leftCount = count / 2;
+  }
+  if (leftCount == 0) {
+    nodes[node].first = first;
+    nodes[node].count = count;
+    for (uint32_t i = first; i < first + count; ++i) {
+      leafOf[order[i]] = node;
+    }
+    return;
+  }
+
+  uint32_t child = nodes.size();
+  nodes[node].first = child;
+  nodes[node].count = 0;
+  nodes.resize(child + 2);
+  parents.resize(child + 2, node);
+  split(child, first, leftCount);
+  split(child + 1, first + leftCount, count - leftCount);
+}
+
+void SceneBVH::refit(std::vector<Model> &models) {
+  if (!sameLayout(models)) {
+    build(models);
+    return;
+  }
+  for (uint32_t m = 0; m < models.size(); ++m) {
+    Model &model = models[m];
+    for (uint32_t t = 0; t < model.instances.size(); ++t) {
+      uint32_t instance = modelFirstInstance[m] + t;
+      Transformation &transformation = model.instances[t];
+      if (versions[instance] == transformation.getVersion()) {
+        continue;
+      }
+      versions[instance] = transformation.getVersion();
+      transforms[instance] = transformation.getWorldMatrix();
+      normalMatrices[instance] = transformation.getNormalMatrix();
+      ++version;
+      for (uint32_t k = 0; k < model.meshes.size(); ++k) {
+        uint32_t id = meshFirstItem[modelFirstMesh[m] + k] + t;
+        updateItem(id, model);
+        // up to the root, or to the first box that did not change
+        uint32_t node = leafOf[id];
+        while (true) {
+          glm::vec3 min = nodes[node].min, max = nodes[node].max;
+          fitNode(node);
+          if (node == 0 || (min == nodes[node].min && max == nodes[node].max)) {
+            break;
+          }
+          node = parents[node];
+        }
+      }
+    }
+  }
+}
+
+bool SceneBVH::sameLayout(const std::vector<Model> &models) const {
+  if (models.size() + 1 != modelFirstMesh.size()) {
+    return false;
+  }
+  size_t itemNum = 0;
+  for (uint32_t m = 0; m < models.size(); ++m) {
+    const Model &model = models[m];
+    if (modelFirstMesh[m] + model.meshes.size() != modelFirstMesh[m + 1] ||
+        modelFirstInstance[m] + model.instances.size() !=
+            modelFirstInstance[m + 1]) {
+      return false;
+    }
+    itemNum += model.meshes.size() * model.instances.size();
+  }
+  return itemNum == items.size();
+}
+
+void SceneBVH::fitNode(uint32_t node) {
+  BVHNode &fitted = nodes[node];
+  VertexBounds bounds = emptyBounds();
+  if (fitted.count > 0) {
+    for (uint32_t i = fitted.first; i < fitted.first + fitted.count; ++i) {
+      grow(bounds, boxes[order[i]]);
+    }
+  } else {
+    for (uint32_t child = fitted.first; child < fitted.first + 2; ++child) {
+      bounds.min = glm::min(bounds.min, nodes[child].min);
+      bounds.max = glm::max(bounds.max, nodes[child].max);
+    }
+  }
+  fitted.min = bounds.min;
+  fitted.max = bounds.max;
+}
+
+void SceneBVH::queryFrustum(const Frustum &frustum,
+                            std::vector<uint32_t> &ids) {
+  ids.clear();
+  candidates.clear();
+  culler.clear();
+  if (nodes.empty()) {
+    return;
+  }
+  // bit i set while plane i still has to be tested below a node
+  const unsigned int ALL_PLANES = (1u << Frustum::PLANE_NUM) - 1;
+  uint32_t stack[STACK_SIZE];
+  unsigned int masks[STACK_SIZE];
+  int top = 0;
+  stack[top] = 0;
+  masks[top++] = ALL_PLANES;
+  while (top > 0) {
+    --top;
+    const BVHNode &node = nodes[stack[top]];
+    unsigned int mask = masks[top];
+    bool outside = false;
+    for (int i = 0; i < Frustum::PLANE_NUM && !outside; ++i) {
+      if (!(mask & (1u << i))) {
+        continue;
+      }
+      const glm::vec4 &plane = frustum.planes[i];
+      // the corners furthest along and against the plane normal
+      glm::vec3 positive(plane.x > 0.0f ? node.max.x : node.min.x,
+                         plane.y > 0.0f ? node.max.y : node.min.y,
+                         plane.z > 0.0f ? node.max.z : node.min.z);
+      glm::vec3 negative(plane.x > 0.0f ? node.min.x : node.max.x,
+                         plane.y > 0.0f ? node.min.y : node.max.y,
+                         plane.z > 0.0f ? node.min.z : node.max.z);
+      if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+        outside = true;
+      } else if (glm::dot(glm::vec3(plane), negative) + plane.w >= 0.0f) {
+        mask &= ~(1u << i);
+      }
+    }
+    if (outside) {
+      continue;
+    }
+    if (node.count == 0) {
+      stack[top] = node.first;
+      masks[top++] = mask;
+      stack[top] = node.first + 1;
+      masks[top++] = mask;
+      continue;
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      if (mask == 0) {
+        ids.push_back(order[i]);
+      } else {
+        candidates.push_back(order[i]);
+        culler.add(spheres[order[i]]);
+      }
+    }
+  }
+
+  culler.cull(frustum, visible);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (visible[i]) {
+      ids.push_back(candidates[i]);
+    }
+  }
+}
+
+void SceneBVH::querySphere(const glm::vec3 &center, float radius,
+                           std::vector<uint32_t> &ids) const {
+  ids.clear();
+  if (nodes.empty()) {
+    return;
+  }
+  float radiusSquared = radius * radius;
+  uint32_t stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const BVHNode &node = nodes[stack[--top]];
+    glm::vec3 offset = center - glm::clamp(center, node.min, node.max);
+    if (glm::dot(offset, offset) > radiusSquared) {
+      continue;
+    }
+    if (node.count == 0) {
+      stack[top++] = node.first;
+      stack[top++] = node.first + 1;
+      continue;
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      const VertexBounds &box = boxes[order[i]];
+      offset = center - glm::clamp(center, box.min, box.max);
+      if (glm::dot(offset, offset) <= radiusSquared) {
+        ids.push_back(order[i]);
+      }
+    }
+  }
+}
+
+bool SceneBVH::intersectRay(const glm::vec3 &origin,
+                            const glm::vec3 &direction, float maxDistance,
+                            uint32_t &id, float &distance) const {
+  if (nodes.empty()) {
+    return false;
+  }
+  // divisions by 0 give infinities, which the slab test handles
+  glm::vec3 inverseDirection = 1.0f / direction;
+  bool hit = false;
+  float entry;
+  uint32_t stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const BVHNode &node = nodes[stack[--top]];
+    if (!intersectBox(node.min, node.max, origin, inverseDirection,
+                      maxDistance, entry)) {
+      continue;
+    }
+    if (node.count == 0) {
+      // the nearer child goes on top, a hit there shortens maxDistance
+      // before the farther one is visited
+      float leftEntry = FLT_MAX, rightEntry = FLT_MAX;
+      const BVHNode &left = nodes[node.first];
+      const BVHNode &right = nodes[node.first + 1];
+      bool hitsLeft = intersectBox(left.min, left.max, origin,
+                                   inverseDirection, maxDistance, leftEntry);
+      bool hitsRight = intersectBox(right.min, right.max, origin,
+                                    inverseDirection, maxDistance, rightEntry);
+      uint32_t nearer = leftEntry <= rightEntry ? node.first : node.first + 1;
+      uint32_t farther = nearer == node.first ? node.first + 1 : node.first;
+      if (hitsLeft && hitsRight) {
+        stack[top++] = farther;
+        stack[top++] = nearer;
+      } else if (hitsLeft || hitsRight) {
+        stack[top++] = hitsLeft ? node.first : node.first + 1;
+      }
+      continue;
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      const VertexBounds &box = boxes[order[i]];
+      if (intersectBox(box.min, box.max, origin, inverseDirection,
+                       maxDistance, entry)) {
+        hit = true;
+        id = order[i];
+        distance = maxDistance = entry;
+      }
+    }
+  }
+  return hit;
+}
+
+size_t SceneBVH::size() const { return items.size(); }
+
+unsigned int SceneBVH::getVersion() const { return version; }
+
+const BVHItem &SceneBVH::item(uint32_t id) const { return items[id]; }
+
+const BoundingSphere &SceneBVH::sphere(uint32_t id) const {
+  return spheres[id];
+}
+
+const VertexBounds &SceneBVH::box(uint32_t id) const { return boxes[id]; }
+
+const glm::mat4 &SceneBVH::transform(uint32_t instance) const {
+  return transforms[instance];
+}
+
+const glm::mat3 &SceneBVH::normalMatrix(uint32_t instance) const {
+  return normalMatrices[instance];
+}
@@ -0,0 +1,108 @@
+
+#ifndef OPENGL_SCENEBVH_H
+#define OPENGL_SCENEBVH_H
+
+#include "../camera/frustum.h"
+#include "boundingvolume.h"
+#include "vertexformat.h"
+#include <cstdint>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+class Model;
+
+// 32 bytes, two siblings share a cache line
+struct BVHNode {
+  glm::vec3 min;
+  // leaf: first entry of its items in the leaf order, interior: the left
+  // child, the right one is stored right after it
+  uint32_t first;
+  glm::vec3 max;
+  // items of a leaf, 0 for interior nodes
+  uint32_t count;
+};
+
+// one mesh of one model instance
+struct BVHItem {
+  uint32_t model;
+  uint32_t mesh;     // into the model's meshes
+  uint32_t instance; // scene wide, see SceneBVH::transform
+};
+
+/**
+ * bounding volume hierarchy over the world space bounds of every mesh
+ * instance in a scene. built top-down with a binned surface area heuristic
+ * into one flat node array, children next to each other, so a traversal
+ * walks forward through memory.
+ * items are numbered model by model, mesh by mesh, instance by instance:
+ * sorted ids group the instances of a mesh. refit() re-reads the
+ * Transformations whose version changed, a parent's change included, and
+ * only grows or shrinks the boxes above them, the tree shape stays until
+ * the next build().
+ */
+class SceneBVH {
+public:
+  // from scratch, whenever models or meshes are added or removed
+  void build(std::vector<Model> &models);
+  // falls back to build() when a model, mesh or instance was added or
+  // removed since
+  void refit(std::vector<Model> &models);
+
+  // items whose bounds touch frustum, unordered. subtrees fully inside are
+  // taken without further tests, the items of partly inside leaves go
+  // through the FrustumCuller batch test
+  void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &ids);
+  // items whose box touches the sphere, e.g. the reach of a point light
+  void querySphere(const glm::vec3 &center, float radius,
+                   std::vector<uint32_t> &ids) const;
+  // nearest item box hit along the ray within maxDistance, triangles are
+  // up to the caller
+  bool intersectRay(const glm::vec3 &origin, const glm::vec3 &direction,
+                    float maxDistance, uint32_t &id, float &distance) const;
+
+  size_t size() const;
+  // changes with every build and with every refit that moved an item
+  unsigned int getVersion() const;
+  const BVHItem &item(uint32_t id) const;
+  const BoundingSphere &sphere(uint32_t id) const;
+  // world space AABB of item id
+  const VertexBounds &box(uint32_t id) const;
+  // world matrix of scene wide instance index
+  const glm::mat4 &transform(uint32_t instance) const;
+  // its normal matrix, both cached by the instance's Transformation
+  const glm::mat3 &normalMatrix(uint32_t instance) const;
+
+private:
+  // models still have the meshes and instances build() numbered
+  bool sameLayout(const std::vector<Model> &models) const;
+  void updateItem(uint32_t id, const Model &model);
+  // splits node, which holds order[first, first + count), until SAH says a
+  // leaf is cheaper
+  void split(uint32_t node, uint32_t first, uint32_t count);
+  // recomputes node's box from its items or children
+  void fitNode(uint32_t node);
+
+  std::vector<BVHNode> nodes;
+  std::vector<uint32_t> parents;
+  // item ids in leaf order
+  std::vector<uint32_t> order;
+  std::vector<BVHItem> items;
+  std::vector<VertexBounds> boxes;
+  std::vector<BoundingSphere> spheres;
+  std::vector<uint32_t> leafOf;
+  // first item of mesh k of model m is meshFirstItem[modelFirstMesh[m] + k]
+  std::vector<uint32_t> modelFirstMesh;
+  std::vector<uint32_t> meshFirstItem;
+  std::vector<uint32_t> modelFirstInstance;
+  std::vector<glm::mat4> transforms;
+  std::vector<glm::mat3> normalMatrices;
+  std::vector<unsigned int> versions;
+  unsigned int version = 0;
+  // reused by the queries
+  FrustumCuller culler;
+  std::vector<unsigned char> visible;
+  std::vector<uint32_t> candidates;
+};
+
+#endif // OPENGL_SCENEBVH_H
@@ -1,5 +1,6 @@
 
 #include "skybox.h"
+#include "../renderengine/glstate.h"
 #include "../renderengine/stb_image.h"
 #include <iostream>
 
@@ -25,7 +26,7 @@ void SkyBox::loadBoxModel() {
       10.0f,  -10.0f, -10.0f, -10.0f, -10.0f, 10.0f,  10.0f,  -10.0f, 10.0f};
 
   glGenVertexArrays(1, &VAO);
-  glBindVertexArray(VAO);
+  GLState::bindVertexArray(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
@@ -33,14 +34,15 @@ void SkyBox::loadBoxModel() {
   glBufferData(GL_ARRAY_BUFFER, sizeof(skyBoxVertices), &skyBoxVertices,
                GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
 
-  glBindVertexArray(0);
+  GLState::bindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void SkyBox::loadTextures(std::vector<std::string> &textures) {
   glGenTextures(1, &textureID);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+  GLState::bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
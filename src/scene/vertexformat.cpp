@@ -0,0 +1,125 @@
+
+#include "vertexformat.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+float signNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+} // namespace
+
+glm::vec3 VertexBounds::scale() const {
+  // 0 on flat axes, every vertex then decodes to min
+  return max - min;
+}
+
+VertexBounds VertexBounds::transformed(const glm::mat4 &transform) const {
+  // Arvo: each matrix entry moves the new min/max by whichever end of the
+  // old range makes it smaller/larger
+  VertexBounds result;
+  result.min = result.max = glm::vec3(transform[3]);
+  for (int column = 0; column < 3; ++column) {
+    for (int row = 0; row < 3; ++row) {
+      float a = transform[column][row] * min[column];
+      float b = transform[column][row] * max[column];
+      result.min[row] += std::min(a, b);
+      result.max[row] += std::max(a, b);
+    }
+  }
+  return result;
+}
+
+VertexBounds VertexFormat::computeBounds(const Vertex *vertices,
+                                         unsigned int vertexCount) {
+  VertexBounds bounds;
+  bounds.min = glm::vec3(0.0f);
+  bounds.max = glm::vec3(0.0f);
+  if (vertexCount > 0) {
+    bounds.min = bounds.max = vertices[0].position;
+  }
+  for (unsigned int i = 1; i < vertexCount; ++i) {
+    bounds.min = glm::min(bounds.min, vertices[i].position);
+    bounds.max = glm::max(bounds.max, vertices[i].position);
+  }
+  return bounds;
+}
+
+std::vector<PackedVertex> VertexFormat::pack(const Vertex *vertices,
+                                             unsigned int vertexCount,
+                                             const VertexBounds &bounds) {
+  glm::vec3 scale = bounds.scale();
+  std::vector<PackedVertex> packed(vertexCount);
+  for (unsigned int i = 0; i < vertexCount; ++i) {
+    const Vertex &vertex = vertices[i];
+    PackedVertex &out = packed[i];
+    for (int c = 0; c < 3; ++c) {
+      float t = scale[c] > 0.0f
+                    ? (vertex.position[c] - bounds.min[c]) / scale[c]
+                    : 0.0f;
+      out.position[c] = glm::packUnorm1x16(t);
+    }
+    float handedness =
+        glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent);
+    out.position[3] = handedness < 0.0f ? 0 : 0xffff;
+
+    glm::vec2 normal = octEncode(vertex.normal);
+    glm::vec2 tangent = octEncode(vertex.tangent);
+    for (int c = 0; c < 2; ++c) {
+      out.normal[c] = int16_t(glm::packSnorm1x16(normal[c]));
+      out.tangent[c] = int16_t(glm::packSnorm1x16(tangent[c]));
+      out.textureCoord[c] = glm::packHalf1x16(vertex.textureCoord[c]);
+    }
+  }
+  return packed;
+}
+
+Vertex VertexFormat::unpack(const PackedVertex &packed,
+                            const VertexBounds &bounds) {
+  Vertex vertex;
+  glm::vec3 scale = bounds.scale();
+  for (int c = 0; c < 3; ++c) {
+    vertex.position[c] =
+        bounds.min[c] + glm::unpackUnorm1x16(packed.position[c]) * scale[c];
+  }
+  vertex.normal = octDecode(
+      glm::vec2(glm::unpackSnorm1x16(uint16_t(packed.normal[0])),
+                glm::unpackSnorm1x16(uint16_t(packed.normal[1]))));
+  vertex.tangent = octDecode(
+      glm::vec2(glm::unpackSnorm1x16(uint16_t(packed.tangent[0])),
+                glm::unpackSnorm1x16(uint16_t(packed.tangent[1]))));
+  float sign = packed.position[3] ? 1.0f : -1.0f;
+  vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * sign;
+  vertex.textureCoord =
+      glm::vec2(glm::unpackHalf1x16(packed.textureCoord[0]),
+                glm::unpackHalf1x16(packed.textureCoord[1]));
+  return vertex;
+}
+
+glm::vec2 VertexFormat::octEncode(glm::vec3 unit) {
+  float length = std::abs(unit.x) + std::abs(unit.y) + std::abs(unit.z);
+  if (length == 0.0f) {
+    return glm::vec2(0.0f);
+  }
+  unit /= length;
+  glm::vec2 encoded(unit.x, unit.y);
+  if (unit.z < 0.0f) {
+    // fold the lower hemisphere over the diagonals
+    encoded = glm::vec2((1.0f - std::abs(unit.y)) * signNotZero(unit.x),
+                        (1.0f - std::abs(unit.x)) * signNotZero(unit.y));
+  }
+  return encoded;
+}
+
+glm::vec3 VertexFormat::octDecode(glm::vec2 encoded) {
+  glm::vec3 unit(encoded.x, encoded.y,
+                 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  if (unit.z < 0.0f) {
+    unit.x = (1.0f - std::abs(encoded.y)) * signNotZero(encoded.x);
+    unit.y = (1.0f - std::abs(encoded.x)) * signNotZero(encoded.y);
+  }
+  return glm::normalize(unit);
+}
@@ -0,0 +1,54 @@
+
+#ifndef OPENGL_VERTEXFORMAT_H
+#define OPENGL_VERTEXFORMAT_H
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+struct Vertex;
+
+// PackedVertex fields bound to attribute locations 0-3
+constexpr unsigned int ATTRIBUTE_NUM = 4;
+
+/**
+ * gpu side vertex layout, 20 bytes instead of the 56 of struct Vertex:
+ *  - position: unorm16 xyz relative to the mesh bounds, w holds the
+ *    bitangent sign (0 or 1), bitangent = cross(normal, tangent) * sign
+ *  - normal, tangent: octahedral encoded unit vectors in snorm16
+ *  - textureCoord: half floats
+ * the vertex shaders undo this with positionScale/positionOffset.
+ */
+struct PackedVertex {
+  uint16_t position[4];
+  int16_t normal[2];
+  int16_t tangent[2];
+  uint16_t textureCoord[2];
+};
+
+// the mesh AABB, positions decode as offset + quantized * scale
+struct VertexBounds {
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::vec3 scale() const;
+  // the AABB around this box after transform
+  VertexBounds transformed(const glm::mat4 &transform) const;
+};
+
+class VertexFormat {
+public:
+  static VertexBounds computeBounds(const Vertex *vertices,
+                                    unsigned int vertexCount);
+  static std::vector<PackedVertex> pack(const Vertex *vertices,
+                                        unsigned int vertexCount,
+                                        const VertexBounds &bounds);
+  // mirrors the shader decode, tangent and bitangent are rebuilt
+  static Vertex unpack(const PackedVertex &packed,
+                       const VertexBounds &bounds);
+  static glm::vec2 octEncode(glm::vec3 unit);
+  static glm::vec3 octDecode(glm::vec2 encoded);
+};
+
+#endif // OPENGL_VERTEXFORMAT_H
@@ -16,7 +16,8 @@ struct DirectLight{
     vec3 diffuse;
     vec3 specular;
     mat4 lightSpaceTrans;
-    sampler2D shadowMap;
+    // directShadowMaps slot, -1 without shadow
+    int shadowIndex;
 };
 
 struct PointLight{
@@ -46,32 +47,39 @@ struct SpotLight{
 //    samplerCube shadowMap;
 };
 
-struct Material{
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float shininess;
-    bool hasDiffuseTex;
-    bool hasSpecularTex;
-    bool hasNormalMap;
-    bool hasDepthMap;
+// one MaterialTable entry, see materialtable.h
+struct MaterialParams{
+    vec4 diffuseShininess;
+    vec4 specularColor;
+    // diffuse, specular, normal and depth texture present
+    ivec4 textureFlags;
+};
+
+struct MaterialTextures{
     sampler2D diffuse;
     sampler2D specular;
     sampler2D normal;
     sampler2D depth;
 };
 
-#define DIRCECT_LIGHTS 2
-#define POINT_LIGHTS 2
-#define SPOT_LIGHTS 2
-#define MATERIALS 1
 uniform int dirNum;
 uniform int pointNum;
 uniform int spotNum;
-uniform DirectLight directLights[DIRCECT_LIGHTS];
-uniform PointLight pointLights[POINT_LIGHTS];
-uniform SpotLight spotLights[SPOT_LIGHTS];
-// only one material present, may extend to mix/blend later
-uniform Material materials[MATERIALS];
+// every light packed by LightBuffer, LIGHT_TEXELS texels each: directional
+// lights first, then point lights, then spot lights
+#define LIGHT_TEXELS 10
+#define DIRECT_SHADOW_MAPS 4
+uniform samplerBuffer lightData;
+uniform sampler2D directShadowMaps[DIRECT_SHADOW_MAPS];
+#define MATERIAL_TABLE_SIZE 256
+layout (std140) uniform MaterialTable
+{
+    MaterialParams materialParams[MATERIAL_TABLE_SIZE];
+};
+uniform int materialIndex;
+uniform MaterialTextures materialTextures;
+// materialParams[materialIndex], set first thing in main
+MaterialParams material;
 uniform vec3 viewPos;
 
 const float gamma = 2.2;
@@ -92,17 +100,23 @@ const float maxLayers = 32;
 vec3 CaculateDirectLight(DirectLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler, vec4 FragPosLightSpace);
 vec3 CaculatePointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler);
 vec3 CaculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler);
+DirectLight fetchDirectLight(int index);
+PointLight fetchPointLight(int index);
+SpotLight fetchSpotLight(int index);
+float directShadow(int shadowIndex, vec4 fragPosLightSpace, float bias);
 float directShadowCalculation(vec4 fragPosLightSpace, sampler2D shadowMap, float bias);
 float pointShadowCalculation(vec3 fragPos, vec3 lightPos, float farPlane, samplerCube shadowMap);
-vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir);
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir);
 
 void main()
 {
+    material = materialParams[materialIndex];
     vec3 resultColor = vec3(0.0f);
     vec3 norm = fs_in.Normal;
-    if(materials[0].hasNormalMap){
-        norm = texture(materials[0].normal, fs_in.TexCoords).rgb;
-        norm = normalize(norm * 2.0 - 1.0);
+    if(material.textureFlags.z != 0){
+        // only xy is stored (BC5 bakes), rebuild z on the unit hemisphere
+        vec2 normXY = texture(materialTextures.normal, fs_in.TexCoords).rg * 2.0 - 1.0;
+        norm = vec3(normXY, sqrt(max(1.0 - dot(normXY, normXY), 0.0)));
         norm = normalize(fs_in.TBN * norm);
     }else{
          norm = normalize(fs_in.Normal);
@@ -110,8 +124,8 @@ void main()
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
     vec3 tangentViewDir = normalize(fs_in.TBN * viewPos - fs_in.TBN * fs_in.FragPos);
     vec2 texCoord;
-    if(materials[0].hasDepthMap){
-        texCoord = ParallaxMapping(materials[0], fs_in.TexCoords, tangentViewDir);
+    if(material.textureFlags.w != 0){
+        texCoord = ParallaxMapping(fs_in.TexCoords, tangentViewDir);
         if(texCoord.x > 1.0 || texCoord.y > 1.0 || texCoord.x < 0.0 || texCoord.y < 0.0)
             discard;
     }else{
@@ -119,28 +133,29 @@ void main()
     }
 
     vec3 diffuseSampler;
-    if(materials[0].hasDiffuseTex){
-        vec4 diffuseTex = texture(materials[0].diffuse, texCoord);
+    if(material.textureFlags.x != 0){
+        vec4 diffuseTex = texture(materialTextures.diffuse, texCoord);
         diffuseSampler = vec3(diffuseTex);
     }else{
-        diffuseSampler = materials[0].diffuseColor;
+        diffuseSampler = material.diffuseShininess.rgb;
     }
     vec3 specularSampler;
-    if(materials[0].hasSpecularTex){
-        specularSampler = vec3(texture(materials[0].specular, texCoord));
+    if(material.textureFlags.y != 0){
+        specularSampler = vec3(texture(materialTextures.specular, texCoord));
     }else{
-        specularSampler = materials[0].specularColor;
+        specularSampler = material.specularColor.rgb;
     }
 
     for(int i = 0; i< dirNum; ++i){
-        vec4 FragPosLightSpace = directLights[i].lightSpaceTrans * vec4(fs_in.FragPos, 1.0);
-        resultColor += CaculateDirectLight(directLights[i], norm, viewDir, diffuseSampler, specularSampler, FragPosLightSpace);
+        DirectLight light = fetchDirectLight(i);
+        vec4 FragPosLightSpace = light.lightSpaceTrans * vec4(fs_in.FragPos, 1.0);
+        resultColor += CaculateDirectLight(light, norm, viewDir, diffuseSampler, specularSampler, FragPosLightSpace);
     }
     for(int i = 0; i< pointNum; ++i){
-        resultColor += CaculatePointLight(pointLights[i], norm, viewDir, diffuseSampler, specularSampler);
+        resultColor += CaculatePointLight(fetchPointLight(dirNum + i), norm, viewDir, diffuseSampler, specularSampler);
     }
     for(int i = 0; i< spotNum; ++i){
-        resultColor += CaculateSpotLight(spotLights[i], norm, viewDir, diffuseSampler, specularSampler);
+        resultColor += CaculateSpotLight(fetchSpotLight(dirNum + pointNum + i), norm, viewDir, diffuseSampler, specularSampler);
     }
 
     resultColor = pow(resultColor, vec3(1.0f/gamma));
@@ -161,14 +176,14 @@ vec3 CaculateDirectLight(DirectLight light, vec3 normal, vec3 viewDir, vec3 diff
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfDir = normalize(lightDir+viewDir);
-    float spec = pow(max(dot(halfDir, normal), 0.0), materials[0].shininess);
+    float spec = pow(max(dot(halfDir, normal), 0.0), material.diffuseShininess.a);
     // combine results
     vec3 ambient = light.ambient * diffuseSampler;
     vec3 diffuse = light.diffuse * diff * diffuseSampler;
     vec3 specular = light.specular * spec * specularSampler;
     // shadow
     float bias = max(0.05 * (1.0 - diff), 0.005);
-    float shadow = directShadowCalculation(FragPosLightSpace, light.shadowMap, bias);
+    float shadow = directShadow(light.shadowIndex, FragPosLightSpace, bias);
     return ambient + (1.0 - shadow)*(diffuse + specular);
 }
 
@@ -178,7 +193,7 @@ vec3 CaculatePointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 diffus
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfDir = normalize(lightDir+viewDir);
-    float spec = pow(max(dot(normal, halfDir), 0.0), materials[0].shininess);
+    float spec = pow(max(dot(normal, halfDir), 0.0), material.diffuseShininess.a);
     // combine results
     vec3 ambient = light.ambient * diffuseSampler;
     vec3 diffuse = light.diffuse * diff * diffuseSampler;
@@ -201,7 +216,7 @@ vec3 CaculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseS
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfDir = normalize(lightDir+viewDir);
-    float spec = pow(max(dot(normal, halfDir), 0.0), materials[0].shininess);
+    float spec = pow(max(dot(normal, halfDir), 0.0), material.diffuseShininess.a);
     // combine results
     vec3 ambient = light.ambient * diffuseSampler;
     vec3 diffuse = light.diffuse * diff * diffuseSampler;
@@ -222,6 +237,66 @@ vec3 CaculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseS
     return ambient + (1.0 - shadow) * (diffuse + specular);
 }
 
+vec4 lightTexel(int index, int texel){
+    return texelFetch(lightData, index * LIGHT_TEXELS + texel);
+}
+
+// texel layout: see LightRecord in light.h
+DirectLight fetchDirectLight(int index){
+    DirectLight light;
+    light.direction = lightTexel(index, 1).xyz;
+    light.ambient = lightTexel(index, 2).rgb;
+    light.diffuse = lightTexel(index, 3).rgb;
+    light.specular = lightTexel(index, 4).rgb;
+    light.lightSpaceTrans = mat4(lightTexel(index, 6), lightTexel(index, 7),
+                                 lightTexel(index, 8), lightTexel(index, 9));
+    light.shadowIndex = int(lightTexel(index, 0).w);
+    return light;
+}
+
+PointLight fetchPointLight(int index){
+    PointLight light;
+    light.position = lightTexel(index, 0).xyz;
+    vec4 ambientLinear = lightTexel(index, 2);
+    vec4 diffuseQuadratic = lightTexel(index, 3);
+    vec4 specularFarPlane = lightTexel(index, 4);
+    light.ambient = ambientLinear.rgb;
+    light.diffuse = diffuseQuadratic.rgb;
+    light.specular = specularFarPlane.rgb;
+    light.constant = lightTexel(index, 1).w;
+    light.linear = ambientLinear.w;
+    light.quadratic = diffuseQuadratic.w;
+    light.farPlane = specularFarPlane.w;
+    return light;
+}
+
+SpotLight fetchSpotLight(int index){
+    PointLight point = fetchPointLight(index);
+    SpotLight light;
+    light.position = point.position;
+    light.direction = lightTexel(index, 1).xyz;
+    light.ambient = point.ambient;
+    light.diffuse = point.diffuse;
+    light.specular = point.specular;
+    light.constant = point.constant;
+    light.linear = point.linear;
+    light.quadratic = point.quadratic;
+    light.farPlane = point.farPlane;
+    vec4 cutoffs = lightTexel(index, 5);
+    light.cutoff = cutoffs.x;
+    light.outCutoff = cutoffs.y;
+    return light;
+}
+
+float directShadow(int shadowIndex, vec4 fragPosLightSpace, float bias){
+    // sampler arrays only take constant indices in glsl 330
+    if(shadowIndex == 0) return directShadowCalculation(fragPosLightSpace, directShadowMaps[0], bias);
+    if(shadowIndex == 1) return directShadowCalculation(fragPosLightSpace, directShadowMaps[1], bias);
+    if(shadowIndex == 2) return directShadowCalculation(fragPosLightSpace, directShadowMaps[2], bias);
+    if(shadowIndex == 3) return directShadowCalculation(fragPosLightSpace, directShadowMaps[3], bias);
+    return 0.0;
+}
+
 float directShadowCalculation(vec4 fragPosLightSpace, sampler2D shadowMap, float bias){
     vec3 projCoord = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoord = projCoord * 0.5 + 0.5;
@@ -257,7 +332,7 @@ float pointShadowCalculation(vec3 fragPos, vec3 lightPos, float farPlane, sample
     return shadow/float(samples);
 }
 
-vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir){
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir){
     // linear interpolation: x*(1-level)+y*level
     float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
     float layerDepth = 1.0 / numLayers;
@@ -267,17 +342,17 @@ vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir){
 
     // init
     vec2 currentTexCoords = texCoords;
-    float currentDepthMapValue = texture(material.depth, currentTexCoords).r;
+    float currentDepthMapValue = texture(materialTextures.depth, currentTexCoords).r;
     while(currentLayerDepth < currentDepthMapValue){
         currentTexCoords -= deltaTexCoords;
-        currentDepthMapValue = texture(material.depth, currentTexCoords).r;
+        currentDepthMapValue = texture(materialTextures.depth, currentTexCoords).r;
         currentLayerDepth += layerDepth;
     }
 
     // interpolation
     vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
     float afterDepth = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(material.depth, prevTexCoords).r - currentLayerDepth + layerDepth;
+    float beforeDepth = texture(materialTextures.depth, prevTexCoords).r - currentLayerDepth + layerDepth;
     float weight = afterDepth / (afterDepth - beforeDepth);
     return prevTexCoords * weight + currentTexCoords * (1.0-weight);
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// one mesh instance, see CullRecord in gpuculler.cpp
+struct CullRecord {
+    vec4 sphere; // world space center, radius
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    uint batch;
+};
+
+// DrawElementsIndirectCommand, 20 bytes under std430
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer CullRecords {
+    CullRecord records[];
+};
+// first command slot of each batch
+layout (std430, binding = 1) readonly buffer BatchOffsets {
+    uint batchOffsets[];
+};
+layout (std430, binding = 2) writeonly buffer DrawCommands {
+    DrawCommand commands[];
+};
+// commands written per batch, read back as the draw counts
+layout (std430, binding = 3) buffer DrawCounts {
+    uint drawCounts[];
+};
+
+// inwards facing, see Frustum in frustum.h
+uniform vec4 planes[6];
+uniform int recordNum;
+// false puts every visible record into batch 0
+uniform bool perBatch;
+
+void main(){
+    uint id = gl_GlobalInvocationID.x;
+    if(id >= uint(recordNum)){
+        return;
+    }
+    CullRecord record = records[id];
+    for(int i = 0; i < 6; ++i){
+        if(dot(planes[i].xyz, record.sphere.xyz) + planes[i].w < -record.sphere.w){
+            return;
+        }
+    }
+    uint batch = perBatch ? record.batch : 0u;
+    uint slot = batchOffsets[batch] + atomicAdd(drawCounts[batch], 1u);
+    // the record buffer is in id order too, baseInstance selects its matrix
+    commands[slot] = DrawCommand(record.count, 1u, record.firstIndex, record.baseVertex, id);
+}
@@ -13,37 +13,47 @@ in VS_OUT{
 } fs_in;
 
 
-struct Material{
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float shininess;
-    bool hasDiffuseTex;
-    bool hasSpecularTex;
-    bool hasNormalMap;
-    bool hasDepthMap;
+// one MaterialTable entry, see materialtable.h
+struct MaterialParams{
+    vec4 diffuseShininess;
+    vec4 specularColor;
+    // diffuse, specular, normal and depth texture present
+    ivec4 textureFlags;
+};
+
+struct MaterialTextures{
     sampler2D diffuse;
     sampler2D specular;
     sampler2D normal;
     sampler2D depth;
 };
 
-#define MATERIALS 1
 uniform vec3 viewPos;
-uniform Material materials[MATERIALS];
+#define MATERIAL_TABLE_SIZE 256
+layout (std140) uniform MaterialTable
+{
+    MaterialParams materialParams[MATERIAL_TABLE_SIZE];
+};
+uniform int materialIndex;
+uniform MaterialTextures materialTextures;
+// materialParams[materialIndex], set first thing in main
+MaterialParams material;
 
 const float heightScale = 0.1;
 const float minLayers = 8;
 const float maxLayers = 32;
 
-vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir);
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir);
 
 void main()
 {
+    material = materialParams[materialIndex];
     gPosition = fs_in.FragPos;
     vec3 norm = fs_in.Normal;
-    if(materials[0].hasNormalMap){
-        norm = texture(materials[0].normal, fs_in.TexCoords).rgb;
-        norm = normalize(norm * 2.0 - 1.0);
+    if(material.textureFlags.z != 0){
+        // only xy is stored (BC5 bakes), rebuild z on the unit hemisphere
+        vec2 normXY = texture(materialTextures.normal, fs_in.TexCoords).rg * 2.0 - 1.0;
+        norm = vec3(normXY, sqrt(max(1.0 - dot(normXY, normXY), 0.0)));
         norm = normalize(fs_in.TBN * norm);
     }else{
          norm = normalize(fs_in.Normal);
@@ -52,28 +62,28 @@ void main()
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
     vec3 tangentViewDir = normalize(fs_in.TBN * viewPos - fs_in.TBN * fs_in.FragPos);
     vec2 texCoord;
-    if(materials[0].hasDepthMap){
-        texCoord = ParallaxMapping(materials[0], fs_in.TexCoords, tangentViewDir);
+    if(material.textureFlags.w != 0){
+        texCoord = ParallaxMapping(fs_in.TexCoords, tangentViewDir);
         if(texCoord.x > 1.0 || texCoord.y > 1.0 || texCoord.x < 0.0 || texCoord.y < 0.0)
             discard;
     }else{
         texCoord = fs_in.TexCoords;
     }
 
-    if(materials[0].hasDiffuseTex){
-        gDiffuse = vec3(texture(materials[0].diffuse, texCoord));
+    if(material.textureFlags.x != 0){
+        gDiffuse = vec3(texture(materialTextures.diffuse, texCoord));
     }else{
-        gDiffuse = materials[0].diffuseColor;
+        gDiffuse = material.diffuseShininess.rgb;
     }
-    if(materials[0].hasSpecularTex){
-        gSpecularShininess.rgb = vec3(texture(materials[0].specular, texCoord));
+    if(material.textureFlags.y != 0){
+        gSpecularShininess.rgb = vec3(texture(materialTextures.specular, texCoord));
     }else{
-        gSpecularShininess.rgb = materials[0].specularColor;
+        gSpecularShininess.rgb = material.specularColor.rgb;
     }
-    gSpecularShininess.a = materials[0].shininess;
+    gSpecularShininess.a = material.diffuseShininess.a;
 }
 
-vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir){
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir){
     // linear interpolation: x*(1-level)+y*level
     float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
     float layerDepth = 1.0 / numLayers;
@@ -83,17 +93,17 @@ vec2 ParallaxMapping(Material material, vec2 texCoords, vec3 viewDir){
 
     // init
     vec2 currentTexCoords = texCoords;
-    float currentDepthMapValue = texture(material.depth, currentTexCoords).r;
+    float currentDepthMapValue = texture(materialTextures.depth, currentTexCoords).r;
     while(currentLayerDepth < currentDepthMapValue){
         currentTexCoords -= deltaTexCoords;
-        currentDepthMapValue = texture(material.depth, currentTexCoords).r;
+        currentDepthMapValue = texture(materialTextures.depth, currentTexCoords).r;
         currentLayerDepth += layerDepth;
     }
 
     // interpolation
     vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
     float afterDepth = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(material.depth, prevTexCoords).r - currentLayerDepth + layerDepth;
+    float beforeDepth = texture(materialTextures.depth, prevTexCoords).r - currentLayerDepth + layerDepth;
     float weight = afterDepth / (afterDepth - beforeDepth);
     return prevTexCoords * weight + currentTexCoords * (1.0-weight);
 }
\ No newline at end of file
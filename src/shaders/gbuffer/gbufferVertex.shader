@@ -1,11 +1,16 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec2 aNormal;
 layout (location = 2) in vec2 aTexture;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec2 aTangent;
 
-uniform mat4 model;
+// per draw constants, see DrawRecord in geometrybuffer.h
+layout (location = 4) in mat4 model;
+// mesh vertices are quantized, see vertexformat.h
+layout (location = 8) in vec3 positionScale;
+layout (location = 9) in vec3 positionOffset;
+// transpose(inverse(mat3(model))), computed on the cpu
+layout (location = 10) in mat3 normalMatrix;
 layout (std140) uniform Matrices
 {
     mat4 projection;
@@ -19,17 +24,25 @@ out VS_OUT{
     mat3 TBN;
 } vs_out;
 
+vec3 octDecode(vec2 e){
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(v.z < 0.0){
+        v.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0f));
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vs_out.TexCoords = vec2(aTexture);
-    vec3 T = normalize(normalMatrix * aTangent);
-    vec3 N = normalize(normalMatrix * aNormal);
+    vec3 position = positionOffset + aPos.xyz * positionScale;
+    vs_out.FragPos = vec3(model * vec4(position, 1.0f));
+    vs_out.TexCoords = aTexture;
+    vec3 T = normalize(normalMatrix * octDecode(aTangent));
+    vec3 N = normalize(normalMatrix * octDecode(aNormal));
     vs_out.Normal = N;
     T = normalize(T - dot(T,N)*N);
-    vec3 B = cross(N, T);
+    // aPos.w holds the bitangent sign as 0/1
+    vec3 B = cross(N, T) * (aPos.w * 2.0 - 1.0);
     vs_out.TBN = mat3(T, B, N);
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = projection * view * model * vec4(position, 1.0f);
 }
\ No newline at end of file
@@ -15,7 +15,8 @@ struct DirectLight{
     vec3 diffuse;
     vec3 specular;
     mat4 lightSpaceTrans;
-    sampler2D shadowMap;
+    // directShadowMaps slot, -1 without shadow
+    int shadowIndex;
 };
 
 struct PointLight{
@@ -45,16 +46,15 @@ struct SpotLight{
 //    samplerCube shadowMap;
 };
 
-#define DIRCECT_LIGHTS 2
-#define POINT_LIGHTS 2
-#define SPOT_LIGHTS 2
 uniform int dirNum;
 uniform int pointNum;
 uniform int spotNum;
-uniform DirectLight directLights[DIRCECT_LIGHTS];
-uniform PointLight pointLights[POINT_LIGHTS];
-uniform SpotLight spotLights[SPOT_LIGHTS];
-// only one material present, may extend to mix/blend later
+// every light packed by LightBuffer, LIGHT_TEXELS texels each: directional
+// lights first, then point lights, then spot lights
+#define LIGHT_TEXELS 10
+#define DIRECT_SHADOW_MAPS 4
+uniform samplerBuffer lightData;
+uniform sampler2D directShadowMaps[DIRECT_SHADOW_MAPS];
 uniform vec3 viewPos;
 
 const float gamma = 2.2;
@@ -73,6 +73,10 @@ const float heightScale = 0.1;
 vec3 CaculateDirectLight(DirectLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler, vec4 FragPosLightSpace, float shininess);
 vec3 CaculatePointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler, float shininess, vec3 FragPos);
 vec3 CaculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseSampler, vec3 specularSampler, float shininess, vec3 FragPos);
+DirectLight fetchDirectLight(int index);
+PointLight fetchPointLight(int index);
+SpotLight fetchSpotLight(int index);
+float directShadow(int shadowIndex, vec4 fragPosLightSpace, float bias);
 float directShadowCalculation(vec4 fragPosLightSpace, sampler2D shadowMap, float bias);
 float pointShadowCalculation(vec3 fragPos, vec3 lightPos, float farPlane, samplerCube shadowMap);
 
@@ -88,14 +92,15 @@ void main()
     vec3 resultColor = vec3(0.0f);
     vec3 viewDir = normalize(viewPos - FragPos);
     for(int i = 0; i< dirNum; ++i){
-        vec4 FragPosLightSpace = directLights[i].lightSpaceTrans * vec4(FragPos, 1.0);
-        resultColor += CaculateDirectLight(directLights[i], norm, viewDir, diffuseSampler, specularSampler, FragPosLightSpace, shininess);
+        DirectLight light = fetchDirectLight(i);
+        vec4 FragPosLightSpace = light.lightSpaceTrans * vec4(FragPos, 1.0);
+        resultColor += CaculateDirectLight(light, norm, viewDir, diffuseSampler, specularSampler, FragPosLightSpace, shininess);
     }
     for(int i = 0; i< pointNum; ++i){
-        resultColor += CaculatePointLight(pointLights[i], norm, viewDir, diffuseSampler, specularSampler, shininess, FragPos);
+        resultColor += CaculatePointLight(fetchPointLight(dirNum + i), norm, viewDir, diffuseSampler, specularSampler, shininess, FragPos);
     }
     for(int i = 0; i< spotNum; ++i){
-        resultColor += CaculateSpotLight(spotLights[i], norm, viewDir, diffuseSampler, specularSampler, shininess, FragPos);
+        resultColor += CaculateSpotLight(fetchSpotLight(dirNum + pointNum + i), norm, viewDir, diffuseSampler, specularSampler, shininess, FragPos);
     }
 
     resultColor = pow(resultColor, vec3(1.0f/gamma));
@@ -123,7 +128,7 @@ vec3 CaculateDirectLight(DirectLight light, vec3 normal, vec3 viewDir, vec3 diff
     vec3 specular = light.specular * spec * specularSampler;
     // shadow
     float bias = max(0.05 * (1.0 - diff), 0.005);
-    float shadow = directShadowCalculation(FragPosLightSpace, light.shadowMap, bias);
+    float shadow = directShadow(light.shadowIndex, FragPosLightSpace, bias);
     return ambient + (1.0 - shadow)*(diffuse + specular);
 }
 
@@ -177,6 +182,66 @@ vec3 CaculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 diffuseS
     return ambient + (1.0 - shadow) * (diffuse + specular);
 }
 
+vec4 lightTexel(int index, int texel){
+    return texelFetch(lightData, index * LIGHT_TEXELS + texel);
+}
+
+// texel layout: see LightRecord in light.h
+DirectLight fetchDirectLight(int index){
+    DirectLight light;
+    light.direction = lightTexel(index, 1).xyz;
+    light.ambient = lightTexel(index, 2).rgb;
+    light.diffuse = lightTexel(index, 3).rgb;
+    light.specular = lightTexel(index, 4).rgb;
+    light.lightSpaceTrans = mat4(lightTexel(index, 6), lightTexel(index, 7),
+                                 lightTexel(index, 8), lightTexel(index, 9));
+    light.shadowIndex = int(lightTexel(index, 0).w);
+    return light;
+}
+
+PointLight fetchPointLight(int index){
+    PointLight light;
+    light.position = lightTexel(index, 0).xyz;
+    vec4 ambientLinear = lightTexel(index, 2);
+    vec4 diffuseQuadratic = lightTexel(index, 3);
+    vec4 specularFarPlane = lightTexel(index, 4);
+    light.ambient = ambientLinear.rgb;
+    light.diffuse = diffuseQuadratic.rgb;
+    light.specular = specularFarPlane.rgb;
+    light.constant = lightTexel(index, 1).w;
+    light.linear = ambientLinear.w;
+    light.quadratic = diffuseQuadratic.w;
+    light.farPlane = specularFarPlane.w;
+    return light;
+}
+
+SpotLight fetchSpotLight(int index){
+    PointLight point = fetchPointLight(index);
+    SpotLight light;
+    light.position = point.position;
+    light.direction = lightTexel(index, 1).xyz;
+    light.ambient = point.ambient;
+    light.diffuse = point.diffuse;
+    light.specular = point.specular;
+    light.constant = point.constant;
+    light.linear = point.linear;
+    light.quadratic = point.quadratic;
+    light.farPlane = point.farPlane;
+    vec4 cutoffs = lightTexel(index, 5);
+    light.cutoff = cutoffs.x;
+    light.outCutoff = cutoffs.y;
+    return light;
+}
+
+float directShadow(int shadowIndex, vec4 fragPosLightSpace, float bias){
+    // sampler arrays only take constant indices in glsl 330
+    if(shadowIndex == 0) return directShadowCalculation(fragPosLightSpace, directShadowMaps[0], bias);
+    if(shadowIndex == 1) return directShadowCalculation(fragPosLightSpace, directShadowMaps[1], bias);
+    if(shadowIndex == 2) return directShadowCalculation(fragPosLightSpace, directShadowMaps[2], bias);
+    if(shadowIndex == 3) return directShadowCalculation(fragPosLightSpace, directShadowMaps[3], bias);
+    return 0.0;
+}
+
 float directShadowCalculation(vec4 fragPosLightSpace, sampler2D shadowMap, float bias){
     vec3 projCoord = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoord = projCoord * 0.5 + 0.5;
@@ -1,9 +1,15 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec2 aNormal;
 
-uniform mat4 model;
+// per draw constants, see DrawRecord in geometrybuffer.h
+layout (location = 4) in mat4 model;
+// mesh vertices are quantized, see vertexformat.h
+layout (location = 8) in vec3 positionScale;
+layout (location = 9) in vec3 positionOffset;
+// transpose(inverse(mat3(model))), computed on the cpu
+layout (location = 10) in mat3 normalMatrix;
 layout (std140) uniform Matrices
 {
     mat4 projection;
@@ -14,7 +20,16 @@ out VS_OUT{
    vec3 Normal;
 }vs_out;
 
+vec3 octDecode(vec2 e){
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(v.z < 0.0){
+        v.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
 void main(){
-    vs_out.Normal = normalize(vec3(projection * vec4(mat3(transpose(inverse(view * model))) * aNormal, 0.0)));
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    vec3 position = positionOffset + aPos.xyz * positionScale;
+    vs_out.Normal = normalize(vec3(projection * vec4(mat3(view) * normalMatrix * octDecode(aNormal), 0.0)));
+    gl_Position = projection * view * model * vec4(position, 1.0f);
 }
\ No newline at end of file
@@ -1,9 +1,13 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;
 
 out vec2 TextureCoord;
 
-uniform mat4 model;
+// per draw constants, see DrawRecord in geometrybuffer.h
+layout (location = 4) in mat4 model;
+// mesh vertices are quantized, see vertexformat.h
+layout (location = 8) in vec3 positionScale;
+layout (location = 9) in vec3 positionOffset;
 uniform mat4 lightSpaceTrans;
 layout (std140) uniform Matrices
 {
@@ -12,8 +16,9 @@ layout (std140) uniform Matrices
 };
 
 void main(){
-    vec4 posLightSpace = lightSpaceTrans * model * vec4(aPos, 1.0f);
+    vec3 position = positionOffset + aPos.xyz * positionScale;
+    vec4 posLightSpace = lightSpaceTrans * model * vec4(position, 1.0f);
     vec3 projCoord = (posLightSpace.xyz / posLightSpace.w) * 0.5 + 0.5;
     TextureCoord = projCoord.xy;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = projection * view * model * vec4(position, 1.0f);
 }
\ No newline at end of file
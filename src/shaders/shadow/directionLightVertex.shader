@@ -1,10 +1,14 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;
 
-uniform mat4 model;
+// per draw constants, see DrawRecord in geometrybuffer.h
+layout (location = 4) in mat4 model;
+// mesh vertices are quantized, see vertexformat.h
+layout (location = 8) in vec3 positionScale;
+layout (location = 9) in vec3 positionOffset;
 uniform mat4 lightSpaceTrans;
 
 void main(){
-    gl_Position = lightSpaceTrans * model * vec4(aPos, 1.0f);
+    gl_Position = lightSpaceTrans * model * vec4(positionOffset + aPos.xyz * positionScale, 1.0f);
 }
@@ -0,0 +1,137 @@
+// cpu only check of the SceneBVH sphere and ray queries: a row of unit
+// cubes with known boxes, queried with spheres and rays whose answers are
+// known. no GL context is created, the meshes never reach the GPU.
+//
+//   bvhcheck
+//
+// prints every failed expectation and exits with 1 if there was one.
+
+#include "../scene/model.h"
+#include "../scene/scenebvh.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// cubes [0, 1]^3 moved to x = 0, SPACING, 2 * SPACING, ...
+const int CUBE_NUM = 8;
+const float SPACING = 3.0f;
+const float EPSILON = 1e-4f;
+
+int failures = 0;
+
+void expect(bool condition, const char *what) {
+  if (!condition) {
+    std::cout << "FAILED: " << what << std::endl;
+    ++failures;
+  }
+}
+
+// one model, one unit cube mesh, CUBE_NUM instances along x
+void buildScene(std::vector<Model> &models) {
+  models.resize(1);
+  Model &model = models[0];
+  model.meshes.resize(1);
+  Mesh &cube = model.meshes[0];
+  cube.bounds.min = glm::vec3(0.0f);
+  cube.bounds.max = glm::vec3(1.0f);
+  cube.sphere.center = glm::vec3(0.5f);
+  cube.sphere.radius = std::sqrt(0.75f);
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    model.instances.push_back(Transformation(
+        glm::vec3(i * SPACING, 0.0f, 0.0f), glm::vec3(1.0f), nullptr));
+  }
+}
+
+// x of the box min of item id, tells the cubes apart
+float cubeX(const SceneBVH &bvh, uint32_t id) { return bvh.box(id).min.x; }
+
+void checkSphere(const SceneBVH &bvh) {
+  std::vector<uint32_t> ids;
+  // inside cube 2 only
+  bvh.querySphere(glm::vec3(2 * SPACING + 0.5f, 0.5f, 0.5f), 0.6f, ids);
+  expect(ids.size() == 1 && std::abs(cubeX(bvh, ids[0]) - 2 * SPACING) <
+                                EPSILON,
+         "a sphere inside one cube finds only that cube");
+
+  // the gap between cube 2 and 3 is SPACING - 1 wide
+  float gap = SPACING - 1.0f;
+  bvh.querySphere(glm::vec3(2 * SPACING + 1.0f + gap * 0.5f, 0.5f, 0.5f),
+                  gap * 0.5f + 0.01f, ids);
+  std::vector<float> xs;
+  for (uint32_t id : ids) {
+    xs.push_back(cubeX(bvh, id));
+  }
+  std::sort(xs.begin(), xs.end());
+  expect(xs.size() == 2 && std::abs(xs[0] - 2 * SPACING) < EPSILON &&
+             std::abs(xs[1] - 3 * SPACING) < EPSILON,
+         "a sphere reaching across a gap finds both neighbours");
+
+  bvh.querySphere(glm::vec3(0.5f, 10.0f, 0.5f), 1.0f, ids);
+  expect(ids.empty(), "a sphere above the row finds nothing");
+
+  bvh.querySphere(glm::vec3(CUBE_NUM * SPACING * 0.5f, 0.5f, 0.5f),
+                  CUBE_NUM * SPACING, ids);
+  expect(ids.size() == size_t(CUBE_NUM),
+         "a sphere around the row finds every cube");
+}
+
+void checkRay(const SceneBVH &bvh) {
+  uint32_t id = ~0u;
+  float distance = -1.0f;
+  // along the row from the left, the first cube is the nearest hit
+  bool hit = bvh.intersectRay(glm::vec3(-5.0f, 0.5f, 0.5f),
+                              glm::vec3(1.0f, 0.0f, 0.0f), 100.0f, id,
+                              distance);
+  expect(hit && std::abs(cubeX(bvh, id)) < EPSILON &&
+             std::abs(distance - 5.0f) < EPSILON,
+         "a ray along the row hits the first cube at distance 5");
+
+  // the same from the right end hits the last one
+  float end = (CUBE_NUM - 1) * SPACING + 1.0f;
+  hit = bvh.intersectRay(glm::vec3(end + 2.0f, 0.5f, 0.5f),
+                         glm::vec3(-1.0f, 0.0f, 0.0f), 100.0f, id, distance);
+  expect(hit &&
+             std::abs(cubeX(bvh, id) - (CUBE_NUM - 1) * SPACING) < EPSILON &&
+             std::abs(distance - 2.0f) < EPSILON,
+         "a ray against the row hits the last cube at distance 2");
+
+  // starting in a gap, the cube ahead and not the one behind
+  hit = bvh.intersectRay(glm::vec3(3 * SPACING - 0.5f, 0.5f, 0.5f),
+                         glm::vec3(1.0f, 0.0f, 0.0f), 100.0f, id, distance);
+  expect(hit && std::abs(cubeX(bvh, id) - 3 * SPACING) < EPSILON &&
+             std::abs(distance - 0.5f) < EPSILON,
+         "a ray from a gap hits the cube ahead of it");
+
+  // straight down onto cube 4, axis parallel, the other slabs divide by 0
+  hit = bvh.intersectRay(glm::vec3(4 * SPACING + 0.5f, 5.0f, 0.5f),
+                         glm::vec3(0.0f, -1.0f, 0.0f), 100.0f, id, distance);
+  expect(hit && std::abs(cubeX(bvh, id) - 4 * SPACING) < EPSILON &&
+             std::abs(distance - 4.0f) < EPSILON,
+         "a vertical ray hits the cube below it");
+
+  hit = bvh.intersectRay(glm::vec3(-5.0f, 0.5f, 0.5f),
+                         glm::vec3(1.0f, 0.0f, 0.0f), 4.0f, id, distance);
+  expect(!hit, "a ray shorter than the distance to the row misses");
+
+  hit = bvh.intersectRay(glm::vec3(-5.0f, 2.0f, 0.5f),
+                         glm::vec3(1.0f, 0.0f, 0.0f), 100.0f, id, distance);
+  expect(!hit, "a ray above the row misses");
+}
+} // namespace
+
+int main() {
+  std::vector<Model> models;
+  buildScene(models);
+  SceneBVH bvh;
+  bvh.build(models);
+  expect(bvh.size() == size_t(CUBE_NUM), "one item per cube instance");
+
+  checkSphere(bvh);
+  checkRay(bvh);
+
+  std::cout << "bvhcheck: " << (failures == 0 ? "ok" : "failed") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
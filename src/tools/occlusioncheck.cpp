@@ -0,0 +1,149 @@
+// cpu only check of the OcclusionCuller: one occluder quad in front of the
+// camera, boxes behind, in front of and beside it. the boxes behind have
+// to be culled and the others kept, and the SSE and scalar rasterizers
+// have to agree on the depth buffer. no GL context is created.
+//
+//   occlusioncheck
+//
+// prints every failed expectation and exits with 1 if there was one.
+
+#include "../scene/model.h"
+#include "../scene/occlusionculler.h"
+#include "../scene/scenebvh.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// the quad spans [-HALF_SIZE, HALF_SIZE] in x and y at z = QUAD_Z, the
+// camera sits at the origin looking down -z
+const float HALF_SIZE = 2.0f;
+const float QUAD_Z = -5.0f;
+// depths of the same pixel from the two paths, a few ulps apart at most
+const float DEPTH_TOLERANCE = 1e-5f;
+
+enum Item { QUAD, BEHIND, IN_FRONT, BESIDE, ITEM_NUM };
+
+int failures = 0;
+
+void expect(bool condition, const char *what) {
+  if (!condition) {
+    std::cout << "FAILED: " << what << std::endl;
+    ++failures;
+  }
+}
+
+Vertex vertexAt(float x, float y, float z) {
+  Vertex vertex = Vertex();
+  vertex.position = glm::vec3(x, y, z);
+  vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+  return vertex;
+}
+
+// model 0: the occluder quad, model 1: a unit cube placed 3 times. items
+// are numbered model by model, so their ids follow Item
+void buildScene(std::vector<Model> &models) {
+  models.resize(2);
+  Model &wall = models[0];
+  wall.meshes.resize(1);
+  Mesh &quad = wall.meshes[0];
+  // slightly off the pixel grid, so no pixel center lies on an edge
+  float size = HALF_SIZE + 0.013f;
+  quad.vertices = {vertexAt(-size, -size, 0.0f), vertexAt(size, -size, 0.0f),
+                   vertexAt(size, size, 0.0f), vertexAt(-size, size, 0.0f)};
+  quad.indices = {0, 1, 2, 0, 2, 3};
+  quad.vertexCount = 4;
+  quad.indexCount = 6;
+  quad.bounds.min = glm::vec3(-size, -size, 0.0f);
+  quad.bounds.max = glm::vec3(size, size, 0.0f);
+  quad.sphere.radius = size * std::sqrt(2.0f);
+  quad.occluder = true;
+  wall.instances.push_back(Transformation(glm::vec3(0.0f, 0.0f, QUAD_Z),
+                                          glm::vec3(1.0f), nullptr));
+
+  Model &boxes = models[1];
+  boxes.meshes.resize(1);
+  Mesh &cube = boxes.meshes[0];
+  cube.bounds.min = glm::vec3(-0.5f);
+  cube.bounds.max = glm::vec3(0.5f);
+  cube.sphere.radius = std::sqrt(0.75f);
+  glm::vec3 positions[3] = {glm::vec3(0.3f, -0.2f, 2.0f * QUAD_Z),
+                            glm::vec3(0.3f, -0.2f, 0.5f * QUAD_Z),
+                            glm::vec3(5.0f * HALF_SIZE, 0.0f, 2.0f * QUAD_Z)};
+  for (const glm::vec3 &position : positions) {
+    boxes.instances.push_back(
+        Transformation(position, glm::vec3(1.0f), nullptr));
+  }
+}
+
+bool contains(const std::vector<uint32_t> &ids, uint32_t id) {
+  return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+// renders the occluder with one path and checks what it culls
+std::vector<float> checkPath(const SceneBVH &bvh,
+                             const std::vector<Model> &models,
+                             const glm::mat4 &viewProjection, bool simd) {
+  OcclusionCuller culler;
+  culler.setSimd(simd);
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 0; id < ITEM_NUM; ++id) {
+    ids.push_back(id);
+  }
+  culler.render(bvh, models, ids, viewProjection);
+  culler.cull(bvh, ids);
+
+  expect(culler.depthAt(OcclusionCuller::WIDTH / 2,
+                        OcclusionCuller::HEIGHT / 2) < 1.0f,
+         "the quad covers the center of the depth buffer");
+  expect(culler.depthAt(0, 0) == 1.0f, "the corner stays at the far plane");
+  expect(!contains(ids, BEHIND), "a box behind the quad is culled");
+  expect(contains(ids, IN_FRONT), "a box in front of the quad is kept");
+  expect(contains(ids, BESIDE), "a box beside the quad is kept");
+  expect(contains(ids, QUAD), "the occluder does not hide itself");
+  expect(culler.testedCount() == ITEM_NUM && culler.occludedCount() == 1,
+         "every item is tested and one is occluded");
+
+  std::vector<float> depth;
+  for (int y = 0; y < OcclusionCuller::HEIGHT; ++y) {
+    for (int x = 0; x < OcclusionCuller::WIDTH; ++x) {
+      depth.push_back(culler.depthAt(x, y));
+    }
+  }
+  return depth;
+}
+} // namespace
+
+int main() {
+  std::vector<Model> models;
+  buildScene(models);
+  SceneBVH bvh;
+  bvh.build(models);
+  expect(bvh.size() == ITEM_NUM, "one item per quad and box instance");
+
+  float aspect = float(OcclusionCuller::WIDTH) / OcclusionCuller::HEIGHT;
+  glm::mat4 viewProjection =
+      glm::perspective(glm::radians(90.0f), aspect, 0.1f, 100.0f);
+
+  std::vector<float> sse = checkPath(bvh, models, viewProjection, true);
+  std::vector<float> scalar = checkPath(bvh, models, viewProjection, false);
+  int covered = 0, mismatched = 0;
+  for (size_t i = 0; i < sse.size(); ++i) {
+    covered += sse[i] < 1.0f;
+    // one covered and the other not, or depths further apart than rounding
+    if ((sse[i] < 1.0f) != (scalar[i] < 1.0f) ||
+        std::abs(sse[i] - scalar[i]) > DEPTH_TOLERANCE) {
+      ++mismatched;
+    }
+  }
+  expect(covered > 0, "the quad covers some pixels");
+  expect(mismatched == 0, "the SSE and scalar depth buffers agree");
+
+  std::cout << "occlusioncheck: " << covered << " pixels covered, "
+            << mismatched << " differ between SSE and scalar, "
+            << (failures == 0 ? "ok" : "failed") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+
+// offline texture baker: compresses every texture referenced by a model's
+// materials into a .ktx2 next to the source image, with a precomputed mip
+// chain. Texture::decode picks the baked file up automatically.
+//
+//   texturebaker [--force] [--verify] <model.obj | material.mtl>...
+//
+// --verify reads every written file back, decodes it on the cpu and reports
+// the PSNR against the source, failing when it drops below MIN_PSNR.
+
+#include "../material/blockcompression.h"
+#include "../material/ktx2.h"
+#include "../renderengine/stb_image.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+
+const double MIN_PSNR = 30.0;
+
+enum class TextureKind { DIFFUSE, NORMAL, MASK };
+
+std::string directoryOf(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+std::string lowerCase(std::string text) {
+  for (char &c : text) {
+    c = (char)tolower(c);
+  }
+  return text;
+}
+
+bool isNewer(const std::string &path, const std::string &than) {
+  struct stat a, b;
+  return stat(path.c_str(), &a) == 0 && stat(than.c_str(), &b) == 0 &&
+         a.st_mtime >= b.st_mtime;
+}
+
+// the material keys the renderer loads, see Model::processMesh
+void parseMaterialFile(const std::string &mtlPath,
+                       std::map<std::string, TextureKind> &textures) {
+  std::ifstream file(mtlPath);
+  if (!file) {
+    std::cout << "cannot open " << mtlPath << std::endl;
+    return;
+  }
+  std::string directory = directoryOf(mtlPath);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream tokens(line);
+    std::string key, token, name;
+    tokens >> key;
+    // options like -bm 1.0 come before the file name, which is last
+    while (tokens >> token) {
+      name = token;
+    }
+    key = lowerCase(key);
+    if (name.empty() || (key.compare(0, 4, "map_") != 0 && key != "bump")) {
+      continue;
+    }
+    bool isNormal = lowerCase(name).find("_ddn") != std::string::npos;
+    TextureKind kind;
+    if (key == "map_kd") {
+      kind = TextureKind::DIFFUSE;
+    } else if (key == "map_bump" || key == "bump" || isNormal) {
+      kind = TextureKind::NORMAL;
+    } else if (key == "map_ks" || key == "map_d" || key == "map_ns" ||
+               key == "map_disp") {
+      kind = TextureKind::MASK;
+    } else {
+      continue;
+    }
+    std::string path = name[0] == '/' ? name : directory + '/' + name;
+    // a texture used both ways keeps the more precise format
+    std::map<std::string, TextureKind>::iterator it = textures.find(path);
+    if (it == textures.end() || kind < it->second) {
+      textures[path] = kind;
+    }
+  }
+}
+
+void collectTextures(const std::string &input,
+                     std::map<std::string, TextureKind> &textures) {
+  std::string extension = lowerCase(input.substr(input.find_last_of('.') + 1));
+  if (extension == "mtl") {
+    parseMaterialFile(input, textures);
+    return;
+  }
+  std::ifstream file(input);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream tokens(line);
+    std::string key, name;
+    tokens >> key >> name;
+    if (key == "mtllib" && !name.empty()) {
+      parseMaterialFile(directoryOf(input) + '/' + name, textures);
+    }
+  }
+}
+
+double psnr(const unsigned char *a, const unsigned char *b, size_t texels,
+            int channels) {
+  double error = 0.0;
+  for (size_t i = 0; i < texels; ++i) {
+    for (int c = 0; c < channels; ++c) {
+      double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+      error += d * d;
+    }
+  }
+  error /= double(texels * channels);
+  return error == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / error);
+}
+
+bool bake(const std::string &path, TextureKind kind, bool force, bool verify,
+          size_t &sourceBytes, size_t &bakedBytes) {
+  std::string bakedPath = Ktx2::bakedPath(path);
+  if (!force && !verify && isNewer(bakedPath, path)) {
+    return true;
+  }
+  int width, height, components;
+  unsigned char *pixels = stbi_load(path.c_str(), &width, &height,
+                                    &components, 4);
+  if (!pixels) {
+    std::cout << "cannot decode " << path << std::endl;
+    return false;
+  }
+  std::vector<unsigned char> rgba(pixels, pixels + size_t(width) * height * 4);
+  stbi_image_free(pixels);
+
+  BlockFormat format = BlockFormat::BC4;
+  int channels = 1;
+  bool isSRGB = false;
+  if (kind == TextureKind::DIFFUSE) {
+    bool hasAlpha = false;
+    for (size_t i = 3; i < rgba.size() && !hasAlpha; i += 4) {
+      hasAlpha = rgba[i] != 255;
+    }
+    format = hasAlpha ? BlockFormat::BC7 : BlockFormat::BC1;
+    channels = hasAlpha ? 4 : 3;
+    isSRGB = true;
+  } else if (kind == TextureKind::NORMAL) {
+    format = BlockFormat::BC5;
+    channels = 2;
+  } else {
+    // masks keep their luminance in the red channel
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+      rgba[i] = (unsigned char)((rgba[i] * 54 + rgba[i + 1] * 183 +
+                                 rgba[i + 2] * 19 + 128) >>
+                                8);
+    }
+  }
+
+  Ktx2Image image;
+  image.vkFormat = Ktx2::vkFormat(format, isSRGB);
+  image.width = width;
+  image.height = height;
+  std::vector<unsigned char> level = rgba;
+  int levelWidth = width, levelHeight = height;
+  while (true) {
+    std::vector<unsigned char> blocks =
+        BlockCompression::compress(level.data(), levelWidth, levelHeight,
+                                   format);
+    image.levels.push_back(Ktx2Level{image.data.size(), blocks.size(),
+                                     levelWidth, levelHeight});
+    image.data.insert(image.data.end(), blocks.begin(), blocks.end());
+    sourceBytes += size_t(levelWidth) * levelHeight * 4;
+    if (levelWidth == 1 && levelHeight == 1) {
+      break;
+    }
+    level = BlockCompression::downsample(
+        level.data(), levelWidth, levelHeight, isSRGB,
+        kind == TextureKind::NORMAL);
+    levelWidth = std::max(1, levelWidth / 2);
+    levelHeight = std::max(1, levelHeight / 2);
+  }
+  bakedBytes += image.data.size();
+  if (!Ktx2::write(bakedPath, image)) {
+    std::cout << "cannot write " << bakedPath << std::endl;
+    return false;
+  }
+
+  if (verify) {
+    Ktx2Image readBack;
+    if (!Ktx2::read(bakedPath, readBack) ||
+        readBack.levels.size() != image.levels.size() ||
+        readBack.data != image.data) {
+      std::cout << "FAIL " << bakedPath << " does not read back" << std::endl;
+      return false;
+    }
+    std::vector<unsigned char> decoded =
+        BlockCompression::decompress(readBack.data.data(), width, height,
+                                     format);
+    double quality = psnr(rgba.data(), decoded.data(),
+                          size_t(width) * height, channels);
+    bool ok = quality >= MIN_PSNR;
+    std::cout << (ok ? "ok   " : "FAIL ") << bakedPath << " " << width << "x"
+              << height << " " << image.levels.size() << " mips, PSNR "
+              << quality << " dB" << std::endl;
+    return ok;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool force = false, verify = false;
+  std::map<std::string, TextureKind> textures;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--force") {
+      force = true;
+    } else if (arg == "--verify") {
+      verify = true;
+    } else {
+      collectTextures(arg, textures);
+    }
+  }
+  if (textures.empty()) {
+    std::cout << "usage: texturebaker [--force] [--verify] "
+                 "<model.obj | material.mtl>..."
+              << std::endl;
+    return 1;
+  }
+
+  size_t sourceBytes = 0, bakedBytes = 0;
+  int failed = 0;
+  for (std::map<std::string, TextureKind>::iterator it = textures.begin();
+       it != textures.end(); ++it) {
+    if (!bake(it->first, it->second, force, verify, sourceBytes,
+              bakedBytes)) {
+      ++failed;
+    }
+  }
+  if (bakedBytes > 0) {
+    std::cout << textures.size() << " textures baked, " << sourceBytes / 1024
+              << " KB as RGBA8 mips -> " << bakedBytes / 1024 << " KB ("
+              << double(sourceBytes) / bakedBytes << "x smaller)"
+              << std::endl;
+  }
+  return failed == 0 ? 0 : 1;
+}
@@ -1,12 +1,34 @@
-
 #include "transformation.h"
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/matrix.hpp>
 
 Transformation::Transformation(const glm::vec3 translation,
-                               const glm::vec3 scale, Rotate *rotate)
-    : translation(translation), scale(scale), rotate(rotate) {}
+                               const glm::vec3 scale, Rotate *rotate,
+                               Transformation *parent)
+    : translation(translation), scale(scale), rotate(rotate),
+      parent(parent) {}
+
+const glm::mat4 &Transformation::getWorldMatrix() {
+  update();
+  return world;
+}
+
+const glm::mat3 &Transformation::getNormalMatrix() {
+  update();
+  return normalMatrix;
+}
 
-glm::mat4 Transformation::getTransformationMat() {
+void Transformation::update() {
+  if (parent != nullptr) {
+    unsigned int current = parent->getVersion();
+    if (current != parentVersion) {
+      parentVersion = current;
+      dirty = true;
+    }
+  }
+  if (!dirty) {
+    return;
+  }
   // glm 的实现需要先平移后scale
   glm::mat4 trans = glm::mat4(1.0f);
   if (rotate != NULL) {
@@ -14,5 +36,34 @@ glm::mat4 Transformation::getTransformationMat() {
   }
   trans = glm::translate(trans, translation);
   trans = glm::scale(trans, scale);
-  return trans;
+  world = parent != nullptr ? parent->world * trans : trans;
+  normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+  dirty = false;
+  ++version;
+}
+
+void Transformation::setTranslation(const glm::vec3 &translation) {
+  this->translation = translation;
+  dirty = true;
+}
+
+void Transformation::setScale(const glm::vec3 &scale) {
+  this->scale = scale;
+  dirty = true;
+}
+
+void Transformation::setRotate(Rotate *rotate) {
+  this->rotate = rotate;
+  dirty = true;
+}
+
+void Transformation::setParent(Transformation *parent) {
+  this->parent = parent;
+  parentVersion = 0;
+  dirty = true;
+}
+
+unsigned int Transformation::getVersion() {
+  update();
+  return version;
 }
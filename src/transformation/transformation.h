@@ -3,20 +3,53 @@
 #define OPENGL_TRANSFORMATION_H
 
 #include "rotate.h"
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 #include <memory>
+
+/**
+ * rotation, translation and scale relative to an optional parent, composed
+ * as rotation * translation * scale: the scaled model is moved, then the
+ * rotation turns it around the parent's origin, position included. the world
+ * and normal matrices are cached and rebuilt only when a setter ran or a
+ * parent's world matrix changed since the last read: every rebuild bumps
+ * the version, and a child compares its parent's version with the one it
+ * was built from, so a change reaches every descendant on its next read.
+ * a parent has to stay at its address and must not be a descendant.
+ */
 class Transformation {
 public:
   Transformation() = default;
   ~Transformation() = default;
   Transformation(const glm::vec3 translation, const glm::vec3 scale,
-                 Rotate *rotate);
-  glm::mat4 getTransformationMat();
+                 Rotate *rotate, Transformation *parent = nullptr);
+  // parent world * rotation * translation * scale
+  const glm::mat4 &getWorldMatrix();
+  // transpose(inverse(mat3(world))), for normals and tangents
+  const glm::mat3 &getNormalMatrix();
+  void setTranslation(const glm::vec3 &translation);
+  void setScale(const glm::vec3 &scale);
+  void setRotate(Rotate *rotate);
+  void setParent(Transformation *parent);
+  // bumped by every rebuild of the world matrix, lets caches such as
+  // SceneBVH spot a change here or further up
+  unsigned int getVersion();
 
 private:
-  glm::vec3 translation;
-  glm::vec3 scale;
-  Rotate *rotate;
+  // rebuilds the matrices when dirty or the parent changed
+  void update();
+
+  glm::vec3 translation = glm::vec3(0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+  Rotate *rotate = nullptr;
+  Transformation *parent = nullptr;
+  // the parent's version the matrices were built from
+  unsigned int parentVersion = 0;
+  bool dirty = true;
+  glm::mat4 world = glm::mat4(1.0f);
+  glm::mat3 normalMatrix = glm::mat3(1.0f);
+  unsigned int version = 0;
 };
 
 #endif // OPENGL_TRANSFORMATION_H
@@ -1,5 +1,7 @@
 
 #include "fileutils.h"
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 
 void FileUtils::savePicture(GLbyte *arr, int size, const std::string &file) {
@@ -17,4 +19,12 @@ void FileUtils::savePicture(GLbyte *arr, int size, const std::string &file) {
 
   fwrite(arr, size, 1, pFile);
   fclose(pFile);
+}
+
+std::string FileUtils::canonicalPath(const std::string &path) {
+  char resolved[PATH_MAX];
+  if (realpath(path.c_str(), resolved) == nullptr) {
+    return path;
+  }
+  return std::string(resolved);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 class FileUtils {
 public:
   static void savePicture(GLbyte *arr, int size, const std::string &file);
+  // absolute path with symlinks and ./.. resolved, unchanged if missing
+  static std::string canonicalPath(const std::string &path);
 };
 
 #endif // OPENGL_FILEUTILS_H
@@ -0,0 +1,41 @@
+
+#include "frametimer.h"
+#include <algorithm>
+#include <iostream>
+
+FrameTimer::FrameTimer(const std::string &name, unsigned int reportInterval)
+    : name(name), reportInterval(reportInterval) {}
+
+void FrameTimer::begin() { start = std::chrono::steady_clock::now(); }
+
+void FrameTimer::end() {
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double ms = elapsed.count();
+  minimum = frames == 0 ? ms : std::min(minimum, ms);
+  maximum = frames == 0 ? ms : std::max(maximum, ms);
+  total += ms;
+  if (++frames < reportInterval) {
+    return;
+  }
+  std::cout << name << ": " << total / frames << " ms avg, " << minimum
+            << " min, " << maximum << " max over " << frames << " frames"
+            << std::endl;
+  for (std::pair<std::string, double> &counter : counters) {
+    std::cout << "  " << counter.first << ": " << counter.second / frames
+              << " per frame" << std::endl;
+    counter.second = 0.0;
+  }
+  frames = 0;
+  total = 0.0;
+}
+
+void FrameTimer::count(const std::string &counter, double value) {
+  for (std::pair<std::string, double> &existing : counters) {
+    if (existing.first == counter) {
+      existing.second += value;
+      return;
+    }
+  }
+  counters.push_back(std::make_pair(counter, value));
+}
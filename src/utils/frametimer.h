@@ -0,0 +1,36 @@
+
+#ifndef OPENGL_FRAMETIMER_H
+#define OPENGL_FRAMETIMER_H
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * cpu time spent recording a frame, from begin() to end(). end() goes before
+ * the buffer swap so that vsync waits are not counted. every reportInterval
+ * frames the average, min and max are printed and the window starts over.
+ * per frame counters, e.g. draw calls, are reported as their average.
+ */
+class FrameTimer {
+public:
+  explicit FrameTimer(const std::string &name, unsigned int reportInterval);
+  void begin();
+  void end();
+  // adds value to this frame's counter of that name
+  void count(const std::string &counter, double value);
+
+private:
+  std::string name;
+  unsigned int reportInterval;
+  unsigned int frames = 0;
+  double total = 0.0;
+  double minimum = 0.0;
+  double maximum = 0.0;
+  // name and sum over the window, in first use order
+  std::vector<std::pair<std::string, double>> counters;
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif // OPENGL_FRAMETIMER_H
@@ -0,0 +1,44 @@
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned int threadNum) {
+  if (threadNum == 0) {
+    threadNum = std::thread::hardware_concurrency();
+  }
+  if (threadNum == 0) {
+    threadNum = 1;
+  }
+  for (unsigned int i = 0; i < threadNum; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+unsigned int ThreadPool::size() const { return workers.size(); }
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      // drain what is queued before shutting down
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop();
+    }
+    job();
+  }
+}
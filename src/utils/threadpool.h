@@ -0,0 +1,52 @@
+
+#ifndef OPENGL_THREADPOOL_H
+#define OPENGL_THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * fixed size worker pool for CPU side jobs (decoding, mesh building...).
+ * jobs must never touch GL: the context only lives on the main thread.
+ */
+class ThreadPool {
+public:
+  // threadNum == 0 means one worker per hardware thread
+  explicit ThreadPool(unsigned int threadNum = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  template <class F>
+  std::future<typename std::result_of<F()>::type> submit(F job) {
+    typedef typename std::result_of<F()>::type Result;
+    std::shared_ptr<std::packaged_task<Result()>> task =
+        std::make_shared<std::packaged_task<Result()>>(job);
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push([task]() { (*task)(); });
+    }
+    condition.notify_one();
+    return future;
+  }
+
+  unsigned int size() const;
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+
+#endif // OPENGL_THREADPOOL_H